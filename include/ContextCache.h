@@ -0,0 +1,103 @@
+#pragma once
+
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/CommandLine.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Diagnostics.h"
+#include "FactMap.h"
+#include "FunctionSummary.h"
+
+namespace dataflow {
+
+extern llvm::cl::opt<unsigned> CallContexts;
+
+struct AnalysisContext;
+
+/**
+ * @brief What a function does when called in one context.
+ */
+struct ContextResult {
+  /// Return range and stores under the argument facts of the context.
+  FunctionSummary summary;
+  /// The accesses of the callee that may be out of bounds there.
+  std::vector<Diagnostic> errors;
+};
+
+/**
+ * @brief Results of functions re-analyzed under the argument intervals and
+ * object sizes of their call sites, for the context-sensitive mode
+ * (-oob-contexts=N).
+ *
+ * The context of a call keeps the arguments that are a single constant, and
+ * the pointer arguments with a single known number of elements behind
+ * them; everything else is abstracted to what the plain summary assumes.
+ * Calls without any such argument just use the plain summary. The
+ * callee is analyzed again with its arguments starting from these facts and
+ * with the sizes of its pointers computed again from the sizes of the
+ * context. Calls inside that analysis use the plain summaries, so the
+ * re-analysis is one call deep. At most N results are kept; the least
+ * recently used one is dropped first. Several threads may look up results.
+ */
+class ContextCache {
+public:
+  /**
+   * @param capacity Maximum number of contexts kept.
+   */
+  ContextCache(const PointerAnalysis &pa, const ObjectSizeAnalysis &sizes,
+               const SummaryTable &summaries, size_t capacity);
+
+  /**
+   * @return nullptr unless -oob-contexts is given and summaries is not null.
+   */
+  static std::unique_ptr<ContextCache> build(const PointerAnalysis &pa,
+                                             const ObjectSizeAnalysis &sizes,
+                                             const SummaryTable *summaries);
+
+  /**
+   * @brief Returns the result of the callee of call in the context facts
+   * describe, analyzing it if it is not cached.
+   * @param facts The facts right before call; the arguments missing from it
+   * are unknown.
+   * @return nullptr if the callee has no summary or no body.
+   */
+  std::shared_ptr<const ContextResult> lookup(const llvm::CallInst *call, const FactMap &facts);
+
+  /**
+   * @brief Looks up the result of every call with a summary in func that
+   * context.specialized does not have yet, with the final facts of the
+   * fixpoint at the call, or those a RangeQuery finds for the arguments the
+   * fixpoint did not track. Called once the fixpoint is done, so the
+   * transfer functions stay free of side effects. If the fixpoint was
+   * degraded, clears context.specialized instead.
+   */
+  void specialize(const llvm::Function &func, AnalysisContext &context);
+
+private:
+  const PointerAnalysis &_pa;
+  const ObjectSizeAnalysis &_sizes;
+  const SummaryTable &_summaries;
+  size_t _capacity;
+
+  using Entry = std::pair<std::string, std::shared_ptr<const ContextResult>>;
+  /// Most recently used first.
+  std::list<Entry> _entries;
+  std::unordered_map<std::string, std::list<Entry>::iterator> _index;
+  std::mutex _mutex;
+
+  /**
+   * @param args The interval of each argument, by argument number.
+   * @param argSizes The number of elements behind the pointer arguments.
+   */
+  std::shared_ptr<const ContextResult> analyze(const llvm::Function &callee,
+                                               const std::map<unsigned, IntervalDomain> &args,
+                                               const std::map<unsigned, IntervalDomain> &argSizes);
+};
+
+} // namespace dataflow
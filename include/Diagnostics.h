@@ -0,0 +1,73 @@
+#pragma once
+
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/raw_ostream.h>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "Domain.h"
+
+namespace dataflow {
+
+extern llvm::cl::opt<std::string> DiagnosticsFile;
+
+/**
+ * @brief A potential out of bounds access, with what a tool reading the
+ * diagnostics needs to know about it.
+ */
+struct Diagnostic {
+  /// Source location from the debug info of the access. Without debug info,
+  /// file is the source file of the module and line and column are 0.
+  std::string file;
+  unsigned line = 0;
+  unsigned column = 0;
+  std::string function;
+  /// The printed IR of the access.
+  std::string instruction;
+  /// The interval of the index and the number of elements of the array.
+  IntervalDomain index, size;
+
+  Diagnostic() = default;
+  Diagnostic(const llvm::Instruction *ins, const IntervalDomain &index,
+             const IntervalDomain &size);
+
+  /**
+   * @brief Writes the diagnostic as one line of JSON.
+   * @param via The call the access was found through in the
+   * context-sensitive mode, if any; its location is written too.
+   */
+  void write(llvm::raw_ostream &os, const llvm::CallInst *via = nullptr) const;
+};
+
+/**
+ * @brief The file of -oob-diagnostics, which gets one JSON object per line
+ * for every error (JSON Lines).
+ *
+ * The records of a function are written and flushed as soon as the function
+ * is reported, in a single write, so a consumer can read the file while the
+ * checker is still running. Several threads, and the forked workers of
+ * -oob-shards, may write to the same stream.
+ */
+class DiagnosticStream {
+public:
+  explicit DiagnosticStream(std::unique_ptr<llvm::raw_fd_ostream> os);
+
+  /**
+   * @brief Opens the file -oob-diagnostics names, "-" for stdout.
+   * @return nullptr if the option is not given or the file cannot be opened.
+   */
+  static std::unique_ptr<DiagnosticStream> open();
+
+  /**
+   * @brief Appends records, a number of complete lines.
+   */
+  void write(llvm::StringRef records);
+
+private:
+  std::unique_ptr<llvm::raw_fd_ostream> _os;
+  std::mutex _mutex;
+};
+
+} // namespace dataflow
@@ -116,6 +116,20 @@ public:
   */
   void clamp(int lo, int hi);
 
+  /**
+   * @brief add the values of an interval to the domain.
+   * @param interval the interval to be added.
+  */
+  void insert(const Interval &interval);
+
+  /**
+   * @brief widen the domain with the value it grew to at a loop head.
+   * Bounds that grew go to infinity, so a loop reaches a fixpoint in a
+   * few iterations instead of one per value of its counter.
+   * @param next the domain joined with the facts of the latest iteration.
+  */
+  void widen(const IntervalDomain &next);
+
   /**
    * @brief check if two domains are equal.
    * @param other the domain to be compared with.
@@ -174,7 +188,7 @@ operator<<(StreamLike &os, const IntervalDomain& domain) {
     os << "empty";
     return os;
   }
-  int i = 0;
+  size_t i = 0;
   for (auto& interval : domain) {
     os << interval << ", "[i == domain.size() - 1];
     ++i;
@@ -53,6 +53,12 @@ public:
     FactMap operator+(const FactMap& other) const {
         return FactMap(*this) += other;
     }
+
+    /**
+     * @brief Widens every fact with its value in next, see IntervalDomain::widen.
+     * @param next The facts this map grew to.
+    */
+    FactMap& widen(const FactMap& next);
     
     /**
      * @brief This function returns true if the two fact maps are equal.
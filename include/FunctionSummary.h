@@ -0,0 +1,112 @@
+#pragma once
+
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/CommandLine.h>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+#include "Domain.h"
+#include "ObjectSize.h"
+#include "PointerAnalysis.h"
+
+namespace dataflow {
+
+struct AnalysisContext;
+
+extern llvm::cl::opt<bool> UseSummaries;
+
+/**
+ * @brief What a call to a function does, as far as its callers' facts are
+ * concerned.
+ *
+ * A summary holds for any argument ranges and any sizes behind the pointer
+ * arguments: it is computed with every argument unknown.
+ */
+struct FunctionSummary {
+  /// Interval of the returned integer, unknown if nothing is known.
+  IntervalDomain ret = IntervalDomain::UNINIT();
+  /// Integers the function may store through each pointer argument, by
+  /// argument number, including the stores of its callees.
+  std::map<unsigned, IntervalDomain> writes;
+
+  /**
+   * @brief Joins into ret what call may store to the memory behind ptr.
+   * @param aliases Also count stores through arguments that may alias ptr,
+   * not only through ptr itself.
+   * @return false if call stores nothing there.
+   */
+  bool written(const llvm::CallInst *call, const llvm::Value *ptr, bool aliases,
+               const PointerAnalysis &pa, IntervalDomain &ret) const;
+};
+
+/**
+ * @brief Summaries of every function defined in a module, computed once,
+ * bottom-up over the strongly connected components of the call graph.
+ *
+ * A function is summarized with RangeQuery, using the summaries of its
+ * callees at its call sites; only values carried around a loop need the
+ * fixpoint. The components that do not call each other are summarized in
+ * parallel. Calls within a component (recursion) are not summarized, they
+ * keep the facts of an unknown call.
+ *
+ * Each function gets one summary, computed with every argument unknown, not
+ * a mapping from argument ranges and sizes to the return range and stores.
+ * A callee whose result depends on its arguments, such as one returning
+ * x + 1, therefore has a top return range. -oob-contexts makes up for this
+ * where it matters: ContextCache analyzes such callees again under the
+ * facts of each call site.
+ */
+class SummaryTable {
+public:
+  /**
+   * @param jobs Number of worker threads, 0 for one per hardware thread.
+   */
+  SummaryTable(llvm::Module &module, const PointerAnalysis &pa, const ObjectSizeAnalysis &sizes,
+               unsigned jobs);
+
+  /**
+   * @brief Summarizes module with -oob-jobs threads.
+   * @return nullptr with -oob-summaries=false.
+   */
+  static std::unique_ptr<SummaryTable> build(llvm::Module &module, const PointerAnalysis &pa,
+                                             const ObjectSizeAnalysis &sizes);
+
+  /**
+   * @brief Summarizes module with jobs threads, for callers that already
+   * run several modules in parallel.
+   * @return nullptr with -oob-summaries=false.
+   */
+  static std::unique_ptr<SummaryTable> build(llvm::Module &module, const PointerAnalysis &pa,
+                                             const ObjectSizeAnalysis &sizes, unsigned jobs);
+
+  /**
+   * @brief Returns the summary of func, or nullptr if it has none.
+   */
+  const FunctionSummary *find(const llvm::Function *func) const;
+
+  /**
+   * @brief Returns the summary of the function call calls directly, or nullptr.
+   */
+  const FunctionSummary *find(const llvm::CallInst *call) const;
+
+  /**
+   * @brief FunctionSummary::written() of the summary of the callee, false if
+   * it has none.
+   */
+  bool written(const llvm::CallInst *call, const llvm::Value *ptr, bool aliases,
+               const PointerAnalysis &pa, IntervalDomain &ret) const;
+
+  /**
+   * @brief Summarizes func given what context says about its arguments and
+   * the functions it calls.
+   */
+  static FunctionSummary summarize(const llvm::Function &func, AnalysisContext &context);
+
+private:
+  /// One entry per defined function, null until it is summarized.
+  std::unordered_map<const llvm::Function *, std::unique_ptr<FunctionSummary>> _summaries;
+};
+
+} // namespace dataflow
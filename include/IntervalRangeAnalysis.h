@@ -0,0 +1,142 @@
+#pragma once
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassManager.h>
+#include <memory>
+
+#include "ContextCache.h"
+#include "FunctionSummary.h"
+#include "OOBChecker.h"
+#include "RangeQuery.h"
+
+namespace dataflow {
+
+/**
+ * @brief The module-wide inputs of the interval analysis: points-to facts,
+ * object sizes and function summaries.
+ */
+struct ModuleFacts {
+  std::unique_ptr<PointerAnalysis> pa;
+  std::unique_ptr<ObjectSizeAnalysis> sizes;
+  /// Unless -oob-summaries=false.
+  std::unique_ptr<SummaryTable> summaries;
+  /// With -oob-contexts.
+  std::unique_ptr<ContextCache> contexts;
+};
+
+/**
+ * @brief New pass manager analysis computing the ModuleFacts.
+ */
+class OOBModuleAnalysis : public llvm::AnalysisInfoMixin<OOBModuleAnalysis> {
+  friend llvm::AnalysisInfoMixin<OOBModuleAnalysis>;
+  static llvm::AnalysisKey Key;
+
+public:
+  struct Result {
+    /// Shared with the IntervalRangeAnalysis results computed from it.
+    std::shared_ptr<ModuleFacts> facts;
+
+    /**
+     * @brief Stale once a pass changes the module without preserving it,
+     * since the facts are keyed by llvm::Value pointers. The
+     * IntervalRangeAnalysis results computed from it are dropped with it.
+     */
+    bool invalidate(llvm::Module &module, const llvm::PreservedAnalyses &preserved,
+                    llvm::ModuleAnalysisManager::Invalidator &invalidator);
+  };
+
+  /**
+   * @brief Also publishes the facts in OOBModuleRegistry.
+   */
+  Result run(llvm::Module &module, llvm::ModuleAnalysisManager &manager);
+};
+
+/**
+ * @brief New pass manager analysis through which function analyses find the
+ * facts of the cached OOBModuleAnalysis.
+ *
+ * Function analyses may only read module results that are never
+ * invalidated, which OOBModuleAnalysis is not, so they read this one
+ * instead. It only holds a weak reference, which expires when the
+ * OOBModuleAnalysis result is invalidated.
+ */
+class OOBModuleRegistry : public llvm::AnalysisInfoMixin<OOBModuleRegistry> {
+  friend llvm::AnalysisInfoMixin<OOBModuleRegistry>;
+  static llvm::AnalysisKey Key;
+
+public:
+  struct Result {
+    std::weak_ptr<ModuleFacts> facts;
+
+    bool invalidate(llvm::Module &, const llvm::PreservedAnalyses &,
+                    llvm::ModuleAnalysisManager::Invalidator &) {
+      return false;
+    }
+  };
+
+  Result run(llvm::Module &, llvm::ModuleAnalysisManager &) { return Result(); }
+};
+
+/**
+ * @brief New pass manager analysis answering interval queries about one
+ * function.
+ *
+ * Ranges are computed on demand with a RangeQuery, so asking about a few
+ * values does not compute the facts of the whole function; context() runs
+ * the full fixpoint the first time it is called. The result is cached by the
+ * function analysis manager, so any number of passes may query ranges
+ * without repeating work. It is dropped when a pass does not preserve it, or
+ * when the cached OOBModuleAnalysis it was computed from is invalidated.
+ */
+class IntervalRangeAnalysis : public llvm::AnalysisInfoMixin<IntervalRangeAnalysis> {
+  friend llvm::AnalysisInfoMixin<IntervalRangeAnalysis>;
+  static llvm::AnalysisKey Key;
+
+public:
+  class Result {
+  public:
+    Result(const llvm::Function &func, std::unique_ptr<PointerAnalysis> pa,
+           std::unique_ptr<ObjectSizeAnalysis> sizes);
+    Result(const llvm::Function &func, std::shared_ptr<ModuleFacts> module);
+
+    /**
+     * @brief Returns the interval of val right before ins executes.
+     */
+    IntervalDomain rangeAt(const llvm::Value *val, const llvm::Instruction *ins) const;
+
+    /**
+     * @brief Returns the number of elements behind ptr right before ins executes.
+     */
+    IntervalDomain sizeAt(const llvm::Value *ptr, const llvm::Instruction *ins) const;
+
+    /**
+     * @brief Stale once a pass changes the function without preserving it.
+     */
+    bool invalidate(llvm::Function &func, const llvm::PreservedAnalyses &preserved,
+                    llvm::FunctionAnalysisManager::Invalidator &invalidator);
+
+    /**
+     * @brief Returns the converged facts of every instruction, and the
+     * results of the callees per call site with -oob-contexts.
+     */
+    AnalysisContext &context();
+    const AnalysisContext &context() const;
+
+  private:
+    const llvm::Function *_func;
+    /// Points-to facts and sizes owned by the result when no module-wide
+    /// ones were cached.
+    std::unique_ptr<PointerAnalysis> _pa;
+    std::unique_ptr<ObjectSizeAnalysis> _sizes;
+    /// Otherwise the module-wide facts, kept alive while the result is.
+    std::shared_ptr<ModuleFacts> _module;
+    /// On the heap, so the query keeps pointing at it when the result moves.
+    std::unique_ptr<AnalysisContext> _context;
+    std::unique_ptr<RangeQuery> _query;
+  };
+
+  Result run(llvm::Function &func, llvm::FunctionAnalysisManager &manager);
+};
+
+} // namespace dataflow
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/raw_ostream.h>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <vector>
+
+#include "Diagnostics.h"
+#include "Domain.h"
+#include "ObjectSize.h"
+#include "PointerAnalysis.h"
+#include "Utils.h"
+
+namespace dataflow {
+
+extern llvm::cl::opt<bool> DemandDrivenPA;
+extern llvm::cl::opt<bool> TriageFunctions;
+extern llvm::cl::opt<bool> TieredAnalysis;
+extern llvm::cl::opt<unsigned> TransferBudget;
+extern llvm::cl::opt<unsigned> TimeBudget;
+
+class ResultCache;
+class SnapshotWriter;
+class SummaryTable;
+class ContextCache;
+struct ContextResult;
+
+struct AnalysisContext {
+  const PointerAnalysis &pa;
+  // array size behind each pointer, computed before the fixpoint
+  const ObjectSizeAnalysis &sizes;
+  // what the called functions return and store, if summarized
+  const SummaryTable *summaries = nullptr;
+  // facts of the arguments when analyzed for one call site, unknown if missing
+  FactMap args;
+  // context-sensitive mode: callees re-analyzed for their call sites, and
+  // the result of each call under its final facts, filled in after the
+  // fixpoint by ContextCache::specialize()
+  ContextCache *contexts = nullptr;
+  std::unordered_map<const llvm::CallInst*, std::shared_ptr<const ContextResult>> specialized;
+  std::unordered_set<const llvm::Value*> pointerSet;
+  InsFactMap in, out;
+  // tiers before the fixpoint: facts of the SSA values they resolved, which
+  // hold wherever the value is defined, and the GEPs they decided
+  FactMap constants;
+  std::unordered_set<const llvm::Instruction*> resolved;
+  // tier 1: the values the fixpoint tracks, all of them if empty
+  std::unordered_set<const llvm::Value*> slice;
+  // the fixpoint ran out of budget and every fact was widened to top
+  bool degraded = false;
+  // instructions visited by the fixpoint, counted against -oob-max-transfers
+  unsigned transfers = 0;
+  // TODO: add other context info here
+};
+
+/**
+ * Transfer functions of single instructions on the facts of their operands,
+ * see Transfer.cpp.
+ */
+bool isInput(const llvm::Instruction *ins);
+IntervalDomain eval(const llvm::BinaryOperator *binOp, const FactMap &inMap);
+IntervalDomain eval(const llvm::CmpInst *cmp, const FactMap &inMap);
+
+/**
+ * How much work a function needs before it can be checked.
+ */
+enum class Triage {
+  /// No getelementptr, nothing to report.
+  NoArrays,
+  /// Every access has a constant index into an array of constant size, so
+  /// it can be checked without any facts.
+  ConstantOnly,
+  NeedsDataflow,
+};
+
+/**
+ * Number of functions in each Triage class; several threads may add to it.
+ */
+struct TriageCounts {
+  std::atomic<size_t> counts[3] = {};
+
+  TriageCounts() = default;
+  TriageCounts(const TriageCounts &other) { add(other); }
+
+  void add(Triage kind) { counts[(int)kind] += 1; }
+  void add(const TriageCounts &other);
+  void print(llvm::raw_ostream &os) const;
+};
+
+/**
+ * The interval analysis and out-of-bounds check, independent of the pass
+ * manager that drives it.
+ */
+struct OOBChecker {
+  /// Default of -oob-max-transfers, per instruction of the function.
+  static inline int maxIterCnt = 100;
+  /// Start of every line report() prints for an error.
+  static constexpr const char *errorMessage = "Potential array out of bounds error: ";
+  /// Start of the line report() prints for a function whose facts were
+  /// widened to top, followed by its name.
+  static constexpr const char *degradedMessage = "Analysis budget exceeded, facts widened to top: ";
+
+  /// Reports of unchanged functions, used by analyzeAndReport() if set.
+  ResultCache *cache = nullptr;
+
+  /// Summaries of the called functions, used by analyzeAndReport() if set.
+  const SummaryTable *summaries = nullptr;
+
+  /// Results of callees re-analyzed per call site, used by
+  /// analyzeAndReport() if set.
+  ContextCache *contexts = nullptr;
+
+  /// Where the errors are also written as JSON records, if set.
+  DiagnosticStream *diagnostics = nullptr;
+
+  /// Where the converged facts of every reported function are recorded, if
+  /// set. The cache is then bypassed, since it only keeps the reports.
+  SnapshotWriter *snapshot = nullptr;
+
+  /// Functions seen by reportWithoutDataflow(), by class.
+  TriageCounts triaged;
+
+  /**
+   * Classifies func in one pass over its instructions. Everything needs
+   * dataflow with -oob-triage=false.
+   */
+  static Triage triage(const llvm::Function &func, const ObjectSizeAnalysis &sizes);
+
+  /**
+   * Reports func right away if triage() shows it needs no facts, and counts
+   * it in triaged. The errors are also written to diagnostics, if set.
+   *
+   * @param err Where the errors are printed.
+   * @return false if func still has to be analyzed.
+   */
+  bool reportWithoutDataflow(const llvm::Function &func, const ObjectSizeAnalysis &sizes,
+                             llvm::raw_ostream &err = llvm::errs());
+
+  /**
+   * Runs the chaotic iteration on func, leaving the converged facts in
+   * context.in and context.out.
+   *
+   * @param func The function to be analyzed.
+   * @param context Context information at this point of the analysis.
+   */
+  void analyze(const llvm::Function &func, AnalysisContext &context);
+
+  /**
+   * Analyzes func in tiers, see Tiers.cpp. Tier 0 propagates constants
+   * through SSA values and non-escaping integer allocas, and decides every
+   * access whose index and array size it resolves. The remaining accesses
+   * are queried on demand with a RangeQuery. Tier 1 runs the chaotic
+   * iteration for the accesses whose values are carried around a loop,
+   * tracking only their backward slice. The facts of tier 1 are left in context.in and context.out, which
+   * stay empty if tier 0 decided everything.
+   *
+   * @param func The function to be analyzed.
+   * @param context Context information at this point of the analysis.
+   */
+  void analyzeTiered(const llvm::Function &func, AnalysisContext &context);
+
+  /**
+   * Returns the instructions of func that may access an array out of bounds,
+   * in program order.
+   *
+   * @param func The analyzed function.
+   * @param context The converged analysis context of func.
+   */
+  std::vector<const llvm::Instruction *> findErrors(const llvm::Function &func,
+                                                    const AnalysisContext &context);
+
+  /**
+   * Returns the index and the array size check() compared for the access
+   * ins, with its source location.
+   *
+   * @param ins An access findErrors() returned.
+   * @param context The converged analysis context of its function.
+   */
+  static Diagnostic diagnose(const llvm::Instruction *ins, const AnalysisContext &context);
+
+  /**
+   * diagnose() given the facts before ins.
+   */
+  static Diagnostic diagnose(const llvm::Instruction *ins, const FactMap &inFacts,
+                             const ObjectSizeAnalysis &sizes);
+
+  /**
+   * Prints the errors of func to stderr and the facts at every instruction
+   * to stdout, if the fixpoint ran. In the context-sensitive mode, the
+   * errors of each callee in the context of a call follow, with the call.
+   * The errors are also written to diagnostics, and the facts recorded in
+   * snapshot, if set.
+   *
+   * @param func The analyzed function.
+   * @param context The converged analysis context of func.
+   * @param out Where the facts are printed.
+   * @param err Where the errors are printed.
+   */
+  void report(const llvm::Function &func, const AnalysisContext &context,
+              llvm::raw_ostream &out = llvm::outs(), llvm::raw_ostream &err = llvm::errs());
+
+  /**
+   * Analyzes func in a fresh context and reports it, see analyze() and
+   * report(), unless reportWithoutDataflow() already did. With a cache, the report of an unchanged function is printed
+   * from the cache instead, and new reports are added to it.
+   */
+  void analyzeAndReport(const llvm::Function &func, const PointerAnalysis &pa,
+                        const ObjectSizeAnalysis &sizes,
+                        llvm::raw_ostream &out = llvm::outs(), llvm::raw_ostream &err = llvm::errs());
+
+  /**
+   * Reports func like analyzeAndReport(), with the context analyzed()
+   * returns, which is only called if the cache has no report of func.
+   */
+  void reportCached(const llvm::Function &func, const PointerAnalysis &pa,
+                    const ObjectSizeAnalysis &sizes,
+                    llvm::function_ref<const AnalysisContext &()> analyzed,
+                    llvm::raw_ostream &out = llvm::outs(), llvm::raw_ostream &err = llvm::errs());
+
+protected:
+  /**
+   * Returns the newly generated facts based on the instruction type/parameters.
+   * @param ins The instruction to be analyzed.
+   * @param context Context information at this point of the analysis.
+   * @return The updated facts.
+   */
+  FactMap genSet(const llvm::Instruction *ins, const AnalysisContext& context);
+  /**
+   * Returns the newly generated facts based on the instruction type/parameters.
+   * @param ins The instruction to be analyzed.
+   * @param context Context information at this point of the analysis.
+   * @return The keys that need to be removed
+   */
+  std::unordered_set<std::string> killSet(const llvm::Instruction *ins, const AnalysisContext& context);
+
+  /**
+   * @brief This function implements the chaotic iteration algorithm using
+   * flowIn(), transfer(), and flowOut().
+   *
+   * The iteration stops once it has applied -oob-max-transfers transfer
+   * functions or run for -oob-max-ms milliseconds. It then widens every fact
+   * to top, which is sound whatever state the iteration stopped in, and sets
+   * context.degraded.
+   *
+   * @param func The function to be analyzed.
+   * @param context Context information at this point of the analysis.
+   */
+  void doAnalysis(const llvm::Function& func, AnalysisContext& context);
+
+  /**
+   * Runs analyzeTiered(), or analyze() with -oob-tiered=false, then
+   * re-analyzes the callees of func per call site if context.contexts is set.
+   */
+  void analyzeSelected(const llvm::Function &func, AnalysisContext &context);
+
+  /**
+   * report(), with the records of the errors appended to records instead of
+   * written to diagnostics. records stays empty if diagnostics is not set.
+   */
+  void report(const llvm::Function &func, const AnalysisContext &context,
+              llvm::raw_ostream &out, llvm::raw_ostream &err, std::string &records);
+
+  /**
+   * Tier 0 of analyzeTiered(): fills context.constants and context.resolved.
+   * @return The accesses tier 0 could not decide.
+   */
+  std::vector<const llvm::Instruction *> resolveConstants(const llvm::Function &func,
+                                                          AnalysisContext &context);
+
+  /**
+   * Fills context.slice with the values the index and the array size of
+   * each access depend on, through operands and through memory.
+   */
+  void computeSlice(const llvm::Function &func, const std::vector<const llvm::Instruction *> &accesses,
+                    AnalysisContext &context);
+
+  /**
+   * Can the Instruction Inst incurr an array out of bounds error?
+   *
+   * @param ins Instruction to check.
+   * @param context Context information at this point of the analysis.
+   * @return true if the instruction can cause an array out of bounds error.
+   */
+  bool check(const llvm::Instruction *ins, const AnalysisContext& context);
+
+  /**
+   * check() given the facts before ins.
+   */
+  static bool check(const llvm::Instruction *ins, const FactMap &inFacts,
+                    const ObjectSizeAnalysis &sizes);
+};
+
+} // namespace dataflow
@@ -1,38 +1,36 @@
 #pragma once
 
-#include <llvm/ADT/SetVector.h>
-#include <llvm/IR/CFG.h>
 #include <llvm/IR/Function.h>
-#include <llvm/IR/InstIterator.h>
-#include <llvm/IR/Instructions.h>
-#include <llvm/IR/ValueMap.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassManager.h>
 #include <llvm/Pass.h>
-#include <llvm/Support/raw_ostream.h>
-#include <algorithm>
-#include <iterator>
-#include <unordered_map>
-#include <unordered_set>
-#include <string>
+#include <memory>
 
-#include "Domain.h"
-#include "PointerAnalysis.h"
-#include "Utils.h"
+#include "ContextCache.h"
+#include "FunctionSummary.h"
+#include "IntervalRangeAnalysis.h"
+#include "OOBChecker.h"
+#include "ParallelDriver.h"
+#include "ResultCache.h"
+#include "ShardedDriver.h"
+#include "Snapshot.h"
 
 namespace dataflow {
-struct AnalysisContext {
-  PointerAnalysis pa;
-  std::unordered_set<const llvm::Value*> pointerSet;
-  InsFactMap in, out;
-  // record array size for each array
-  std::unordered_map<const llvm::Value*, int> arraySizeMap;
-  // TODO: add other context info here
-};
 
-struct OOBCheckerPass : public llvm::FunctionPass {
+/**
+ * Legacy pass manager driver: `opt -load OOBChecker.so -OOBChecker`.
+ */
+struct OOBCheckerPass : public llvm::FunctionPass, public OOBChecker {
   static char ID;
-  static inline int maxIterCnt = 1000;
   OOBCheckerPass() : llvm::FunctionPass(ID) {}
 
+  /**
+   * Solves the points-to constraints and object sizes of the whole module,
+   * and summarizes its functions, once, before any function is analyzed.
+   */
+  bool doInitialization(llvm::Module &module) override;
+  bool doFinalization(llvm::Module &module) override;
+
   /**
    * This function is called for each function F in the input C program
    * that the compiler encounters during a pass.
@@ -40,39 +38,56 @@ struct OOBCheckerPass : public llvm::FunctionPass {
   bool runOnFunction(llvm::Function &func) override;
 
 protected:
-  /**
-   * Returns the newly generated facts based on the instruction type/parameters.
-   * @param ins The instruction to be analyzed.
-   * @param context Context information at this point of the analysis.
-   * @return The updated facts.
-   */
-  FactMap genSet(const llvm::Instruction *ins, AnalysisContext& context);
-  /**
-   * Returns the newly generated facts based on the instruction type/parameters.
-   * @param ins The instruction to be analyzed.
-   * @param context Context information at this point of the analysis.
-   * @return The keys that need to be removed
-   */
-  std::unordered_set<std::string> killSet(const llvm::Instruction *ins, AnalysisContext& context);
+  /// Points-to facts shared by every function of the current module.
+  std::unique_ptr<PointerAnalysis> modulePA;
+  /// Object sizes shared by every function of the current module.
+  std::unique_ptr<ObjectSizeAnalysis> moduleSizes;
+  /// Function summaries, unless -oob-summaries=false.
+  std::unique_ptr<SummaryTable> moduleSummaries;
+  /// Callees re-analyzed per call site, with -oob-contexts.
+  std::unique_ptr<ContextCache> moduleContexts;
+  /// Reports of unchanged functions, if -oob-cache is given.
+  std::unique_ptr<ResultCache> resultCache;
+  /// The file of -oob-diagnostics, if given.
+  std::unique_ptr<DiagnosticStream> diagnosticStream;
+  /// The facts written to -oob-snapshot at the end, if given.
+  std::unique_ptr<SnapshotWriter> snapshotWriter;
 
-  /**
-   * @brief This function implements the chaotic iteration algorithm using
-   * flowIn(), transfer(), and flowOut().
-   *
-   * @param func The function to be analyzed.
-   * @param context Context information at this point of the analysis.
-   */
-  void doAnalysis(const llvm::Function& func, AnalysisContext& context);
+  const char* getAnalysisName() const { return "OOBCheckerPass"; }
+};
 
-  /**
-   * Can the Instruction Inst incurr an array out of bounds error?
-   *
-   * @param ins Instruction to check.
-   * @param context Context information at this point of the analysis.
-   * @return true if the instruction can cause an array out of bounds error.
-   */
-  bool check(llvm::Instruction *ins, const AnalysisContext& context);
+/**
+ * Legacy pass manager driver analyzing all functions of a module in
+ * parallel: `opt -load OOBChecker.so -OOBCheckerParallel -oob-jobs=N`, or in
+ * worker processes with `-oob-shards=N`.
+ */
+struct OOBCheckerParallelPass : public llvm::ModulePass {
+  static char ID;
+  OOBCheckerParallelPass() : llvm::ModulePass(ID) {}
 
-  const char* getAnalysisName() const { return "OOBCheckerPass"; }
+  bool runOnModule(llvm::Module &module) override;
+};
+
+/**
+ * New pass manager driver: `opt -load-pass-plugin OOBChecker.so
+ * -passes=oob-checker`, or `clang -fpass-plugin=OOBChecker.so`.
+ *
+ * All the work happens in OOBModuleAnalysis and IntervalRangeAnalysis; the
+ * pass only asks for their results and reports them. With -oob-cache, the
+ * reports of unchanged functions come from the cache instead, without
+ * asking for their IntervalRangeAnalysis.
+ */
+struct OOBCheckerNewPass : public llvm::PassInfoMixin<OOBCheckerNewPass>, public OOBChecker {
+  llvm::PreservedAnalyses run(llvm::Module &module, llvm::ModuleAnalysisManager &manager);
+
+  static const char* getAnalysisName() { return "OOBCheckerPass"; }
+};
+
+/**
+ * New pass manager driver analyzing all functions of a module in parallel:
+ * `opt -load-pass-plugin OOBChecker.so -passes=oob-checker-parallel`.
+ */
+struct OOBCheckerParallelNewPass : public llvm::PassInfoMixin<OOBCheckerParallelNewPass> {
+  llvm::PreservedAnalyses run(llvm::Module &module, llvm::ModuleAnalysisManager &manager);
 };
 } // namespace dataflow
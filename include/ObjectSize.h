@@ -0,0 +1,171 @@
+#pragma once
+
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Instructions.h>
+#include <functional>
+#include <map>
+#include <unordered_map>
+
+#include "Domain.h"
+#include "FactMap.h"
+#include "PointerAnalysis.h"
+
+namespace dataflow {
+
+/**
+ * @brief Number of elements behind a pointer.
+ *
+ * Either a constant range of element counts, or symbolic: the interval of
+ * `symbol` where the pointer is used, times scale / divisor, minus the
+ * `offset` elements the pointer has already been advanced by. Symbolic sizes
+ * cover malloc(n * sizeof(int)), calloc(n, sizeof(int)) and VLAs, whose
+ * length is only known to the interval analysis itself.
+ */
+struct ObjectSize {
+  IntervalDomain elements;
+  const llvm::Value *symbol = nullptr;
+  int scale = 1;
+  int divisor = 1;
+  int offset = 0;
+
+  /// Nothing is known: at least zero elements.
+  static ObjectSize unknown();
+
+  bool isSymbolic() const { return symbol != nullptr; }
+  bool operator==(const ObjectSize &other) const {
+    return elements == other.elements && symbol == other.symbol &&
+           scale == other.scale && divisor == other.divisor && offset == other.offset;
+  }
+  bool operator!=(const ObjectSize &other) const { return !(*this == other); }
+
+  /**
+   * @brief Returns the size left after advancing the pointer by `by` elements.
+   */
+  ObjectSize shifted(int by) const;
+
+  /**
+   * @brief Joins with the size of another allocation the pointer may refer to.
+   * @return true if this size changed.
+   */
+  bool join(const ObjectSize &other);
+
+  /**
+   * @brief Evaluates the size given the facts where the pointer is used.
+   */
+  IntervalDomain evaluate(const FactMap &facts) const;
+};
+
+/**
+ * @brief Number of array elements reachable through each pointer of a module.
+ *
+ * Sizes are computed once, before the interval analysis runs, and stay
+ * read-only afterwards. Allocation sites (array allocas, VLAs, malloc and
+ * calloc) seed the table; casts, GEPs with a constant offset, phis, call
+ * arguments and pointers stored to and reloaded from memory (resolved
+ * through the points-to solution) join the sizes of their sources. Since
+ * sizes only ever grow, the result is the same whatever order the
+ * instructions are visited in.
+ */
+class ObjectSizeAnalysis {
+public:
+  ObjectSizeAnalysis(llvm::Module &module, const PointerAnalysis &pa);
+
+  /**
+   * @brief Sizes of the values of func alone, as a points-to analysis of func
+   * alone sees them: its arguments have no size.
+   */
+  ObjectSizeAnalysis(const llvm::Function &func, const PointerAnalysis &pa);
+
+  /**
+   * @brief Sizes in func as at one call site, where the pointer arguments
+   * point to the number of elements in argSizes, by argument number.
+   *
+   * Only the values of func are computed again. Arguments missing from
+   * argSizes, the values of other functions, and the memory other functions
+   * may write keep their sizes in base, which must outlive this table.
+   */
+  ObjectSizeAnalysis(const ObjectSizeAnalysis &base, const llvm::Function &func,
+                     const std::map<unsigned, IntervalDomain> &argSizes);
+
+  /**
+   * @brief Returns the number of elements reachable through ptr.
+   * @param ptr The pointer to look up.
+   * @param facts The facts where ptr is used, to evaluate symbolic sizes.
+   * @return The size, or [0, 0] if nothing is known about ptr.
+   */
+  IntervalDomain lookup(const llvm::Value *ptr, const FactMap &facts) const;
+
+  /**
+   * @brief Returns true if a size was inferred for ptr.
+   */
+  bool contains(const llvm::Value *ptr) const {
+    return find(ptr) != nullptr;
+  }
+
+  /**
+   * @brief Returns the size inferred for ptr, or nullptr.
+   */
+  const ObjectSize *find(const llvm::Value *ptr) const {
+    auto iter = _sizes.find(ptr);
+    if (iter != _sizes.end()) {
+      return &iter->second;
+    }
+    return _base ? _base->find(ptr) : nullptr;
+  }
+
+  /**
+   * @brief Calls visit with every pointer of this table and its size, not
+   * those of the base table.
+   */
+  template <typename Visit> void forEach(Visit visit) const {
+    for (auto &entry : _sizes) {
+      visit(entry.first, entry.second);
+    }
+  }
+
+private:
+  const PointerAnalysis &_pa;
+  using SizeMap = std::unordered_map<const llvm::Value *, ObjectSize>;
+  SizeMap _sizes;
+  /// Joined size of the pointers stored into each memory object.
+  SizeMap _contents;
+  /// Whether missing sizes are still pending or already known to be unknown.
+  bool _final = false;
+  /// For the sizes of one call site: the table of the module, and the
+  /// function computed again.
+  const ObjectSizeAnalysis *_base = nullptr;
+  const llvm::Function *_func = nullptr;
+
+  /**
+   * @brief Runs visitAll until no size changes, first without and then
+   * with the missing sizes treated as unknown.
+   */
+  void solve(const std::function<bool()> &visitAll);
+
+  /**
+   * @brief Joins the size of val with size.
+   * @return true if the recorded size changed.
+   */
+  bool update(SizeMap &map, const llvm::Value *val, ObjectSize size);
+
+  /**
+   * @brief Reads the size of val into size.
+   * @return false if the size is not known yet and should be skipped.
+   */
+  bool read(const SizeMap &map, const llvm::Value *val, ObjectSize &size) const;
+
+  /**
+   * @brief Returns the size of an allocation site, if it is one.
+   */
+  bool allocationSize(const llvm::Instruction *ins, ObjectSize &size) const;
+
+  /**
+   * @brief Returns the memory objects a store or load through ptr touches.
+   */
+  std::vector<const llvm::Value *> objects(const llvm::Value *ptr) const;
+
+  bool visit(const llvm::Instruction *ins);
+  bool visit(const llvm::Argument *arg);
+};
+
+} // namespace dataflow
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <llvm/IR/Module.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "OOBChecker.h"
+
+namespace dataflow {
+
+extern llvm::cl::opt<unsigned> Jobs;
+
+/**
+ * @brief Analyzes the functions of a module concurrently on a thread pool.
+ *
+ * The analysis of a function only reads the IR and the shared, already
+ * solved points-to facts and object sizes; everything it writes lives in its
+ * own AnalysisContext. Each task therefore just needs its own NameScope, and
+ * buffers its report so the output of the whole module comes out in source
+ * order, exactly as a sequential run would print it.
+ */
+class ParallelDriver : public OOBChecker {
+public:
+  /**
+   * @param jobs Number of worker threads, 0 for one per hardware thread.
+   */
+  ParallelDriver(const PointerAnalysis &pa, const ObjectSizeAnalysis &sizes, unsigned jobs);
+
+  /**
+   * @brief Analyzes every function defined in module and prints the reports.
+   * @param module The module to be analyzed.
+   * @param name The analysis name printed before each function's report.
+   * @param out Where the facts are printed.
+   * @param err Where the errors are printed.
+   */
+  void run(const llvm::Module &module, llvm::StringRef name,
+           llvm::raw_ostream &out = llvm::outs(), llvm::raw_ostream &err = llvm::errs());
+
+private:
+  const PointerAnalysis &_pa;
+  const ObjectSizeAnalysis &_sizes;
+  unsigned _jobs;
+};
+
+} // namespace dataflow
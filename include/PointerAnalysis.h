@@ -2,7 +2,12 @@
 #define POINTER_ANALYSIS_H
 
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+#include <map>
 #include <set>
+#include <tuple>
+#include <vector>
 
 namespace dataflow {
 
@@ -17,25 +22,72 @@ using PointsToSet = std::set<std::string>;
  *
  */
 using PointsToInfo = std::map<std::string, PointsToSet>;
+
+/**
+ * @brief A points-to constraint extracted from a single instruction.
+ *
+ * Addr:  Dst points to the allocation site Src
+ * Copy:  Dst points to whatever Src points to (Dst = Src)
+ * Load:  Dst points to whatever the targets of Src point to (Dst = *Src)
+ * Store: the targets of Dst point to whatever Src points to (*Dst = Src)
+ */
+struct Constraint {
+  enum KindTy { Addr, Copy, Load, Store };
+  KindTy Kind;
+  std::string Dst;
+  std::string Src;
+
+  bool operator<(const Constraint &Other) const {
+    return std::tie(Kind, Dst, Src) < std::tie(Other.Kind, Other.Dst, Other.Src);
+  }
+  bool operator==(const Constraint &Other) const {
+    return Kind == Other.Kind && Dst == Other.Dst && Src == Other.Src;
+  }
+};
+using ConstraintList = std::vector<Constraint>;
+
 class PointerAnalysis {
 public:
   /**
    * @brief Build a points-to graph
    *
-   * This constructor applies the pointer analysis transfer function
-   * on each instruction in function F.
+   * This constructor extracts the constraints of each instruction in
+   * function F, merges pointer-equivalent variables offline and then solves
+   * the reduced constraint system.
    *
    * @param F The function for which pointer analysis is done
+   * @param DemandDriven Only solve for the pointers that can influence an
+   * array access (see collectDemand()).
+   * @param Log Where the solved points-to sets are printed with -oob-verbose
    */
-  PointerAnalysis(llvm::Function &F);
+  PointerAnalysis(llvm::Function &F, bool DemandDriven = false,
+                  llvm::raw_ostream &Log = llvm::errs());
 
   /**
-   * @brief If the instruction is memory allocation, store, or load, updates the points-to sets.
+   * @brief Build a points-to graph for a whole module
+   *
+   * Like the per-function constructor, but the constraints of all defined
+   * functions are solved together. Actual arguments flow into the formal
+   * parameters of the callee and returned pointers flow back into the call,
+   * so pointers passed to helper functions keep their targets. Values are
+   * qualified with their function name to keep the keys unique.
+   *
+   * @param M The module for which pointer analysis is done
+   * @param DemandDriven Only solve for the pointers that can influence an
+   * array access (see collectDemand()).
+   * @param Log Where the solved points-to sets are printed with -oob-verbose
+   */
+  PointerAnalysis(llvm::Module &M, bool DemandDriven = false,
+                  llvm::raw_ostream &Log = llvm::errs());
+
+  /**
+   * @brief If the instruction is memory allocation, store, or load, records
+   * the points-to constraint it induces.
    *
    * @param Inst The instruction to be analyzed for aliasing
-   * @param PointsTo The set of 
+   * @param Constraints The list the constraint is appended to
    */
-  void transfer(llvm::Instruction *Inst, PointsToInfo &PointsTo);
+  void transfer(llvm::Instruction *Inst, ConstraintList &Constraints);
 
   /**
    * @brief Returns true if two pointers are aliased
@@ -44,10 +96,109 @@ public:
    * @param Ptr2 Second pointer
    * @return bool  
    */
-  bool alias(std::string &Ptr1, std::string &Ptr2) const;
+  bool alias(const llvm::Value *Ptr1, const llvm::Value *Ptr2) const;
+
+  /**
+   * @brief Returns the allocation sites a pointer may point to
+   *
+   * @param Ptr The pointer
+   * @return The allocas and allocation calls Ptr may point to, empty if
+   * nothing is known about Ptr
+   */
+  std::vector<const llvm::Value *> pointees(const llvm::Value *Ptr) const;
+
+  /**
+   * @brief Returns the names of the allocation sites a pointer may point to
+   *
+   * Unlike pointees(), the names stay valid after the bodies of other
+   * functions have been deleted.
+   *
+   * @param Ptr The pointer
+   * @return The sorted names of the objects Ptr may point to
+   */
+  std::vector<std::string> pointeeNames(const llvm::Value *Ptr) const;
+
+  /**
+   * @brief Returns the variables merged away by value numbering
+   *
+   * @return Each merged variable, mapped to the representative whose
+   * points-to set it shares
+   */
+  const std::map<std::string, std::string> &valueNumbers() const { return Rep; }
 
 private:
   PointsToInfo PointsTo;
+  /// Allocation site behind each object key.
+  std::map<std::string, const llvm::Value *> Objects;
+  /// Printable name of each object key.
+  std::map<std::string, std::string> ObjectNames;
+  /// Whether keys are qualified with the enclosing function (module mode).
+  bool Qualified = false;
+  /// Variables merged away by reduce(), mapped to their representative.
+  std::map<std::string, std::string> Rep;
+
+  /**
+   * @brief Returns the key of a pointer variable in the points-to graph.
+   */
+  std::string key(const llvm::Value *Val) const;
+
+  /**
+   * @brief Returns the key of the allocation site Val in the points-to graph.
+   */
+  std::string object(const llvm::Value *Val) const;
+
+  /**
+   * @brief Returns the key standing for the return value of Func.
+   */
+  std::string returnKey(const llvm::Function &Func) const;
+
+  /**
+   * @brief Returns the representative a variable was merged into.
+   */
+  const std::string &find(const std::string &Var) const;
+
+  /**
+   * @brief Offline hash-based value numbering (HVN) over the constraints.
+   *
+   * Top-level variables with a single defining constraint get a value number
+   * derived from the kind of that constraint and the value number of its
+   * operand, e.g. every reload of the same stack slot at -O0 gets the same
+   * number. Variables sharing a value number have identical points-to sets,
+   * so all but one of them are rewritten to a representative and the
+   * duplicate constraints are dropped before solving.
+   *
+   * @param Constraints The constraints to reduce in place
+   */
+  void reduce(ConstraintList &Constraints);
+
+  /**
+   * @brief Solve the constraints to a fixed point.
+   *
+   * @param Constraints The (reduced) constraints
+   */
+  void solve(const ConstraintList &Constraints);
+
+  /**
+   * @brief Collect the instructions whose transfer can affect an array access.
+   *
+   * Starts from the base and index operands of every GetElementPtrInst and
+   * walks backwards over the values they are computed from. Whenever a
+   * pointer is reached, the loads and stores through it (and the pointers
+   * derived from it) are followed as well, so every pointer that may alias a
+   * relevant one ends up in the slice. In module mode, arguments and
+   * returned values are followed across calls between the given functions.
+   *
+   * @param Funcs The functions to slice
+   * @param Slice Receives the relevant instructions in program order
+   */
+  void collectDemand(const std::vector<llvm::Function *> &Funcs,
+                     std::vector<llvm::Instruction *> &Slice);
+
+  /**
+   * @brief Extract, reduce and solve the constraints of the given functions.
+   */
+  void build(const std::vector<llvm::Function *> &Funcs, bool DemandDriven,
+             llvm::raw_ostream &Log);
 
   /**
    * @brief 
@@ -62,7 +213,7 @@ private:
    *
    * @param PointsTo 
    */
-  void print(std::map<std::string, PointsToSet> &PointsTo);
+  void print(std::map<std::string, PointsToSet> &PointsTo, llvm::raw_ostream &OS);
 };
 }; // namespace dataflow
 
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instruction.h>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "FunctionSummary.h"
+#include "OOBChecker.h"
+
+namespace dataflow {
+
+/**
+ * @brief Answers interval queries for single values, without computing the
+ * facts of the whole function.
+ *
+ * A query walks backward from the value: through the operands of SSA values,
+ * and, for a load, through the control-flow graph to the stores that may
+ * write the memory it reads. It applies the transfer functions of the
+ * fixpoint to what it finds, so the answers are the facts the chaotic
+ * iteration would compute. Answers are memoized across queries.
+ *
+ * A value that depends on itself (a loop counter, a phi in a loop header)
+ * cannot be answered that way. queryRange() then runs the forward fixpoint
+ * on context once and reads the answer from there; tryQuery() just fails.
+ */
+class RangeQuery {
+public:
+  /**
+   * @param func The function queries are about.
+   * @param context Where the forward fixpoint is run if a query needs it.
+   * Facts already in there are used as they are.
+   */
+  RangeQuery(const llvm::Function &func, AnalysisContext &context);
+
+  /**
+   * @brief Returns the interval of val right before ins executes. For a
+   * pointer, that is the interval of the integer it points to.
+   */
+  IntervalDomain queryRange(const llvm::Value *val, const llvm::Instruction *ins);
+
+  /**
+   * @brief Returns the number of elements behind ptr right before ins
+   * executes.
+   */
+  IntervalDomain querySize(const llvm::Value *ptr, const llvm::Instruction *ins);
+
+  /**
+   * @brief Like queryRange(), without the fallback.
+   * @return false if val depends on itself.
+   */
+  bool tryQuery(const llvm::Value *val, const llvm::Instruction *ins, IntervalDomain &ret);
+
+  /**
+   * @brief Runs the forward fixpoint unless it already ran.
+   */
+  void analyzeAll();
+
+private:
+  const llvm::Function &_func;
+  AnalysisContext &_context;
+  /// Facts of SSA values, which hold wherever the value is defined.
+  std::unordered_map<const llvm::Value *, IntervalDomain> _values;
+  /// Facts of memory right before an instruction.
+  std::map<std::pair<const llvm::Value *, const llvm::Instruction *>, IntervalDomain> _memory;
+  /// Values being evaluated, to find the ones that depend on themselves.
+  std::unordered_set<const llvm::Value *> _active;
+  /// Values known to depend on themselves.
+  std::unordered_set<const llvm::Value *> _cyclic;
+  /// Memoized while the current query ran, dropped if it fails.
+  std::vector<const llvm::Value *> _addedValues;
+  std::vector<std::pair<const llvm::Value *, const llvm::Instruction *>> _addedMemory;
+  bool _failed = false;
+
+  IntervalDomain value(const llvm::Value *val);
+  IntervalDomain evaluate(const llvm::Instruction *ins);
+  IntervalDomain memory(const llvm::Value *ptr, const llvm::Instruction *ins);
+
+  /**
+   * @brief Returns the summary of the callee of call, for the context of
+   * the call if context-sensitive, or nullptr.
+   */
+  const FunctionSummary *summaryOf(const llvm::CallInst *call);
+
+  /**
+   * @brief Joins into ret what the paths leading to ins write to ptr.
+   * @return false if no path writes ptr.
+   */
+  bool reaching(const llvm::Value *ptr, const llvm::Instruction *ins, IntervalDomain &ret);
+};
+
+} // namespace dataflow
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <llvm/IR/Function.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "FunctionSummary.h"
+#include "ObjectSize.h"
+#include "PointerAnalysis.h"
+
+namespace dataflow {
+
+extern llvm::cl::opt<std::string> CacheFile;
+
+/**
+ * @brief Persistent cache of per-function results, keyed by content.
+ *
+ * The key of a function hashes everything its analysis reads: the printed
+ * IR of the function, the definitions of the globals it refers to (the
+ * facts fold in their initializers), the points-to sets and object sizes
+ * the module-wide analyses computed for its values (which is where callers
+ * and callees come in), the summaries of the functions it calls, with
+ * -oob-contexts the bodies and globals of the callees it re-analyzes, and
+ * the checker configuration, and with -oob-diagnostics the source
+ * locations of its instructions. A function with the same key would be
+ * analyzed to the same report, so the cached one is printed instead.
+ *
+ * The file is a sorted index of fixed-size entries followed by the reports,
+ * and is memory mapped when opened; lookups binary search the mapping
+ * without parsing the file. New results are kept in memory until save()
+ * merges them into the file. Lookups and inserts may come from several
+ * threads, and several processes may share the file.
+ *
+ * Every entry records when it was last added or hit. Once the file grows
+ * past -oob-cache-limit, save() drops the least recently used entries,
+ * which are mostly those of functions that have changed since.
+ */
+class ResultCache {
+public:
+  using Key = std::array<uint8_t, 16>;
+
+  /**
+   * @brief Opens the cache at path. A missing or unreadable file is an empty
+   * cache.
+   */
+  explicit ResultCache(std::string path);
+
+  /**
+   * @brief Returns the key of func under the given module-wide results.
+   */
+  static Key key(const llvm::Function &func, const PointerAnalysis &pa,
+                 const ObjectSizeAnalysis &sizes, const SummaryTable *summaries = nullptr);
+
+  /**
+   * @brief Reads the report cached for key.
+   * @param out Receives the facts printed for the function.
+   * @param err Receives the errors printed for the function.
+   * @param records Receives the -oob-diagnostics records of the errors.
+   * @return true on a hit.
+   */
+  bool lookup(const Key &key, std::string &out, std::string &err, std::string &records) const;
+
+  /**
+   * @brief Records the report of a function analyzed in this run.
+   */
+  void insert(const Key &key, std::string out, std::string err, std::string records);
+
+  /**
+   * @brief Writes the old and the new entries back to the file.
+   *
+   * Holds a lock on <path>.lock meanwhile, and merges with the file as it
+   * is then, so that processes saving to the same cache keep each other's
+   * entries.
+   * @return false if the file could not be written.
+   */
+  bool save();
+
+private:
+  struct Report {
+    std::string out, err, records;
+  };
+
+  std::string _path;
+  std::unique_ptr<llvm::MemoryBuffer> _file;
+  uint32_t _count = 0;
+  std::map<Key, Report> _added;
+  /// Entries of the file hit in this run whose time of use is out of date.
+  mutable std::set<Key> _hit;
+  mutable std::mutex _mutex;
+
+  /**
+   * @brief Maps the file at _path, if it is a valid cache.
+   */
+  void open();
+  bool lookupFile(const Key &key, std::string &out, std::string &err, std::string &records,
+                  uint32_t *used = nullptr) const;
+};
+
+} // namespace dataflow
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <llvm/IR/Module.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/raw_ostream.h>
+#include <vector>
+
+#include "OOBChecker.h"
+
+namespace dataflow {
+
+extern llvm::cl::opt<unsigned> Shards;
+extern llvm::cl::opt<unsigned> ShardTimeout;
+
+/**
+ * @brief Analyzes the functions of a module in forked worker processes.
+ *
+ * Functions are split into shards of about equal total size, deterministically
+ * for a given module. Each worker inherits the loaded module and the solved
+ * points-to facts and object sizes from the coordinator, analyzes its shard,
+ * and streams one record per function back over a pipe. The coordinator
+ * prints the records in source order, as a sequential run would. A worker
+ * that crashes or runs out of time only loses the functions it had not
+ * reported yet; those are listed on stderr.
+ *
+ * Workers do not load the bitcode again, although that would keep the
+ * memory of each worker to its own shard: the driver runs inside a pass,
+ * whose module may have come from stdin or been changed by earlier passes,
+ * so the file on disk is not necessarily what is being checked, and its
+ * function indices and points-to facts could differ from the coordinator's.
+ * Forked workers share the coordinator's pages until they write to them,
+ * so their memory mostly grows with the facts of their own shard.
+ */
+class ShardedDriver : public OOBChecker {
+public:
+  /**
+   * @param shards Number of worker processes.
+   * @param timeout Seconds the whole run may take before the remaining
+   * workers are killed, 0 for no limit.
+   */
+  ShardedDriver(const PointerAnalysis &pa, const ObjectSizeAnalysis &sizes, unsigned shards,
+                unsigned timeout);
+
+  /**
+   * @brief Analyzes every function defined in module and prints the reports.
+   * @param module The module to be analyzed.
+   * @param name The analysis name printed before each function's report.
+   * @param out Where the facts are printed.
+   * @param err Where the errors are printed.
+   */
+  void run(const llvm::Module &module, llvm::StringRef name,
+           llvm::raw_ostream &out = llvm::outs(), llvm::raw_ostream &err = llvm::errs());
+
+  /**
+   * @brief Splits functions into count shards of about equal instruction count.
+   * @return For each shard, the indices into functions it analyzes, ascending.
+   */
+  static std::vector<std::vector<size_t>> partition(const std::vector<const llvm::Function *> &functions,
+                                                   unsigned count);
+
+private:
+  const PointerAnalysis &_pa;
+  const ObjectSizeAnalysis &_sizes;
+  unsigned _shards;
+  unsigned _timeout;
+
+  /**
+   * @brief Body of a worker process: analyzes the shard and writes the
+   * records to fd.
+   */
+  void work(const std::vector<const llvm::Function *> &functions, const std::vector<size_t> &shard,
+            int fd);
+};
+
+} // namespace dataflow
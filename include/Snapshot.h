@@ -0,0 +1,183 @@
+#pragma once
+
+#include <llvm/IR/Module.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Domain.h"
+#include "FactMap.h"
+#include "ObjectSize.h"
+#include "PointerAnalysis.h"
+
+namespace dataflow {
+
+extern llvm::cl::opt<std::string> SnapshotFile;
+
+struct AnalysisContext;
+
+/**
+ * @brief Collects what a run computed, for the file of -oob-snapshot.
+ *
+ * For each module: the object size table and the value numbers of the
+ * points-to analysis. For each reported function: its converged facts,
+ * stored per basic block. The first instruction of a block carries the
+ * facts at the entry of the block, and every instruction then only the
+ * facts its IN and OUT change, so a block is read back by replaying it from
+ * its entry. The facts the tiers resolved for SSA values are stored once per
+ * function, since they hold wherever the value is defined.
+ *
+ * Each function is encoded on its own as soon as it is reported, into a blob
+ * that only refers to itself, so the forked workers of -oob-shards can send
+ * theirs to the coordinator. save() writes the file at the end of the run.
+ * Functions may be added from several threads.
+ */
+class SnapshotWriter {
+public:
+  explicit SnapshotWriter(std::string path);
+
+  /**
+   * @brief Returns the writer of -oob-snapshot, or nullptr if the option is
+   * not given.
+   */
+  static std::unique_ptr<SnapshotWriter> open();
+
+  /**
+   * @brief Records the size table and value numbers of module. Must be
+   * called before the functions of module are added.
+   */
+  void addModule(const llvm::Module &module, const PointerAnalysis &pa,
+                 const ObjectSizeAnalysis &sizes);
+
+  /**
+   * @brief Records the converged facts of func.
+   */
+  void add(const llvm::Function &func, const AnalysisContext &context);
+
+  /**
+   * @brief Removes the blob of func and returns it, empty if func was not
+   * added.
+   */
+  std::string take(const llvm::Function &func);
+
+  /**
+   * @brief Adds the blob take() returned in another process.
+   */
+  void insert(const llvm::Function &func, std::string blob);
+
+  /**
+   * @brief Writes the file.
+   * @return false if it could not be written.
+   */
+  bool save();
+
+private:
+  struct Module {
+    std::string source;
+    struct Size {
+      std::string value, symbol;
+      IntervalDomain elements;
+      int scale, divisor, offset;
+    };
+    std::vector<Size> sizes;
+    std::vector<std::pair<std::string, std::string>> valueNumbers;
+  };
+  struct Function {
+    std::string name;
+    uint32_t module;
+    std::string blob;
+  };
+
+  std::string _path;
+  std::vector<Module> _modules;
+  std::unordered_map<const llvm::Module *, uint32_t> _moduleIds;
+  std::vector<Function> _functions;
+  std::mutex _mutex;
+
+  void append(const llvm::Function &func, std::string blob);
+};
+
+/**
+ * @brief A file written by -oob-snapshot, memory mapped and read in place.
+ */
+class Snapshot {
+public:
+  struct Function {
+    std::string name;
+    uint32_t module;
+    /// The fixpoint ran, rather than only the tiers.
+    bool fixpoint;
+    /// The fixpoint ran out of budget and its facts were widened to top.
+    bool degraded;
+    uint32_t index;
+  };
+  struct Instruction {
+    std::string name, block;
+    /// From the debug info, 0 without.
+    unsigned line;
+  };
+  struct Size {
+    std::string value, symbol;
+    IntervalDomain elements;
+    int scale, divisor, offset;
+  };
+
+  /**
+   * @brief Maps the file at path.
+   * @return nullptr with error set if it is not a valid snapshot.
+   */
+  static std::unique_ptr<Snapshot> open(const std::string &path, std::string &error);
+
+  /**
+   * @brief Returns the source file names of the modules.
+   */
+  std::vector<std::string> modules() const;
+
+  /**
+   * @brief Returns the functions, sorted by name.
+   */
+  std::vector<Function> functions() const;
+
+  /**
+   * @brief Returns the functions called name, one per module.
+   */
+  std::vector<Function> find(llvm::StringRef name) const;
+
+  /**
+   * @brief Returns the instructions of func, in program order.
+   * @return false if the blob of func is damaged.
+   */
+  bool instructions(const Function &func, std::vector<Instruction> &ret) const;
+
+  /**
+   * @brief Rebuilds the facts before and after one instruction of func.
+   * @return false if the blob of func is damaged.
+   */
+  bool facts(const Function &func, uint32_t instruction, FactMap &in, FactMap &out) const;
+
+  /**
+   * @brief Reads the facts the tiers resolved in func.
+   */
+  bool constants(const Function &func, FactMap &ret) const;
+
+  std::vector<Size> sizes(uint32_t module) const;
+
+  /**
+   * @brief Returns the variables the points-to analysis merged, with their
+   * representative.
+   */
+  std::vector<std::pair<std::string, std::string>> valueNumbers(uint32_t module) const;
+
+private:
+  std::unique_ptr<llvm::MemoryBuffer> _file;
+
+  explicit Snapshot(std::unique_ptr<llvm::MemoryBuffer> file) : _file(std::move(file)) {}
+};
+
+} // namespace dataflow
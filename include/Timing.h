@@ -0,0 +1,43 @@
+#pragma once
+
+#include <llvm/Support/Timer.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace dataflow {
+
+/**
+ * @brief The phases of a run that -time-passes reports.
+ *
+ * Phases may nest: the summaries include the fixpoints they run.
+ */
+enum class Phase { PointsTo, ObjectSizes, Summaries, Fixpoint, Checking, Printing, Count };
+
+/**
+ * @brief Adds the time it is alive to phase, with -time-passes.
+ *
+ * The times of all threads are summed up per phase, so a run with -oob-jobs
+ * reports the time spent by every thread rather than the elapsed time. They
+ * are kept process-wide because analyses also run inside RangeQuery and the
+ * per call site contexts, where no driver is around.
+ */
+class PhaseTimer {
+public:
+  explicit PhaseTimer(Phase phase);
+  ~PhaseTimer();
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+  Phase _phase;
+  bool _enabled;
+  llvm::TimeRecord _start;
+};
+
+/**
+ * @brief Prints the times of the phases as the "OOB Checker" timer group
+ * and resets them. Does nothing without -time-passes.
+ */
+void printPhaseTimes(llvm::raw_ostream &os);
+
+} // namespace dataflow
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <llvm/IR/Function.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/raw_ostream.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Domain.h"
+#include "FactMap.h"
+
+namespace dataflow {
+
+extern llvm::cl::opt<std::string> TraceFile;
+extern llvm::cl::opt<bool> TraceCompress;
+
+/**
+ * @brief The file of -oob-trace, which records how the facts of every
+ * function analyzed by the chaotic iteration evolve.
+ *
+ * The file starts with a header and is followed by chunks. A chunk holds
+ * whole events of one function and is compressed on its own with
+ * -oob-trace-compress. Each function gets an ID the chunks carry, so the
+ * chunks of functions analyzed at the same time, by several threads or by
+ * the forked workers of -oob-shards, may be interleaved. An event is a tag
+ * followed by unsigned LEB128 numbers and length-prefixed strings:
+ *
+ *   Function: the name, the number of instructions and the name of each;
+ *     instructions are then referred to by their position.
+ *   Slot: the name of a fact key, numbered from 0 in order of appearance.
+ *   Domain: a domain, numbered from 1 in order of appearance; unknown, or
+ *     the (signed LEB128) bounds of its intervals.
+ *   Visit: the instruction the iteration visited, and the slots of its IN
+ *     and OUT facts that changed, each with its new domain, or 0 if the
+ *     fact was removed.
+ *   End: whether the facts were widened to top, and the number of visits.
+ *
+ * The writer is process-wide because analyses also run inside RangeQuery
+ * and the per call site contexts, where no driver is around.
+ */
+class TraceWriter {
+public:
+  /// Event tags.
+  enum : uint8_t { Function = 1, Slot, Domain, Visit, End };
+
+  /**
+   * @brief Returns the writer of -oob-trace, opening the file on the first
+   * call, or nullptr if the option is not given or the file cannot be
+   * written.
+   */
+  static TraceWriter *instance();
+
+  /**
+   * @brief Returns a new function ID, unique across forked processes.
+   */
+  uint64_t newFunction();
+
+  /**
+   * @brief Appends raw, whole events of function as one chunk.
+   */
+  void write(uint64_t function, llvm::StringRef raw);
+
+private:
+  explicit TraceWriter(std::unique_ptr<llvm::raw_fd_ostream> os);
+
+  std::unique_ptr<llvm::raw_fd_ostream> _os;
+  std::atomic<uint32_t> _functions{0};
+  std::mutex _mutex;
+};
+
+/**
+ * @brief Records the visits of the chaotic iteration on one function as the
+ * events of a TraceWriter.
+ *
+ * Only the facts that changed since the previous visit of the same
+ * instruction are written, and every fact key and domain is written once;
+ * afterwards a fact costs two small numbers.
+ */
+class TraceRecorder {
+public:
+  TraceRecorder(TraceWriter &writer, const llvm::Function &func);
+  ~TraceRecorder();
+  TraceRecorder(const TraceRecorder &) = delete;
+  TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+  void visit(const llvm::Instruction *ins, const FactMap &in, const FactMap &out);
+
+  /**
+   * @brief Ends the trace of the function and writes what is buffered.
+   */
+  void finish(bool degraded);
+
+private:
+  /// Slot of each fact key, to domain handle.
+  using Snapshot = std::unordered_map<uint32_t, uint32_t>;
+  /// Slots with their new domain handle, 0 if removed.
+  using Changes = std::vector<std::pair<uint32_t, uint32_t>>;
+
+  TraceWriter &_writer;
+  uint64_t _function;
+  std::string _buffer;
+  llvm::raw_string_ostream _stream;
+  std::unordered_map<const llvm::Instruction *, uint32_t> _ids;
+  std::unordered_map<std::string, uint32_t> _slots;
+  std::vector<const std::string *> _slotNames;
+  /// Handle of each encoded domain.
+  std::unordered_map<std::string, uint32_t> _domains;
+  /// The facts of each instruction as of its last visit.
+  std::vector<Snapshot> _in, _out;
+  Changes _inChanges, _outChanges;
+  std::string _encoded;
+  uint64_t _visits = 0;
+  bool _finished = false;
+
+  uint32_t slot(const std::string &key);
+  uint32_t domain(const IntervalDomain &val);
+  /**
+   * @brief Fills changes with the difference from last to facts, and
+   * updates last.
+   */
+  void diff(Snapshot &last, const FactMap &facts, Changes &changes);
+  void writeChanges(const Changes &changes);
+  void flush();
+};
+
+/**
+ * @brief A function read back from a trace.
+ */
+struct TraceFunction {
+  struct Visit {
+    uint32_t ins;
+    /// Changed slots with their new domain handle, 0 if removed.
+    std::vector<std::pair<uint32_t, uint32_t>> in, out;
+  };
+
+  std::string name;
+  std::vector<std::string> instructions;
+  std::vector<std::string> slots;
+  /// Domain of each handle, starting at handle 1.
+  std::vector<IntervalDomain> domains;
+  /// Only kept for the functions asked for.
+  std::vector<Visit> visits;
+  uint64_t visitCount = 0;
+  bool finished = false;
+  bool degraded = false;
+
+  /**
+   * @brief Rebuilds the IN and OUT facts of every instruction after the
+   * first count visits, widened to top after the last one if the function
+   * ran out of budget.
+   */
+  void replay(uint64_t count, std::vector<FactMap> &in, std::vector<FactMap> &out) const;
+};
+
+/**
+ * @brief Reads the trace at path.
+ * @param keep Also keep the visits of functions with this name; all
+ * functions if empty, none if null.
+ * @return false with error set if the file is not a valid trace.
+ */
+bool readTrace(const std::string &path, std::vector<TraceFunction> &functions,
+               const std::string *keep, std::string &error);
+
+} // namespace dataflow
@@ -6,12 +6,26 @@
 #include <llvm/IR/Value.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/InstIterator.h>
+#include <llvm/IR/ModuleSlotTracker.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/raw_ostream.h>
+#include <string>
+#include <vector>
 extern const char *WHITESPACES;
 
 namespace dataflow {
 
 using InsFactMap = std::unordered_map<const llvm::Instruction*, FactMap>;
 
+extern llvm::cl::opt<unsigned> Verbosity;
+extern llvm::cl::list<std::string> DumpFunctions;
+
+/**
+ * @brief Are the facts of func printed? Only with -oob-verbose=2, and only
+ * for the functions -oob-dump-function names, if any.
+ */
+bool dumpsFacts(const llvm::Function &func);
+
 /**
  * @brief Get a human-readable string name for an llvm Value
  *
@@ -20,6 +34,27 @@ using InsFactMap = std::unordered_map<const llvm::Instruction*, FactMap>;
  */
 std::string variable(const llvm::Value *val);
 
+/**
+ * @brief Caches the names variable() returns on the current thread while it
+ * is alive, and numbers unnamed values of func once instead of on every call.
+ *
+ * Each analysis thread opens its own scope around the function it analyzes.
+ * The IR must not change while a scope is open.
+ */
+class NameScope {
+public:
+  explicit NameScope(const llvm::Function &func);
+  ~NameScope();
+  NameScope(const NameScope &) = delete;
+  NameScope &operator=(const NameScope &) = delete;
+
+private:
+  friend std::string variable(const llvm::Value *val);
+  llvm::ModuleSlotTracker _slots;
+  std::unordered_map<const llvm::Value *, std::string> _names;
+  NameScope *_outer;
+};
+
 /**
  * @brief Encode the memory address of an llvm Value
  *
@@ -28,6 +63,14 @@ std::string variable(const llvm::Value *val);
  */
 std::string address(const llvm::Value *val);
 
+/**
+ * @brief Is the value a call to a heap allocation function (malloc, calloc)?
+ *
+ * @param val The llvm Value to check
+ * @return true if val allocates a new heap object
+ */
+bool isAllocationCall(const llvm::Value *val);
+
 /**
  * @brief Print the Before and After domains of an instruction
  * wrt. In and Out memory.
@@ -38,9 +81,49 @@ std::string address(const llvm::Value *val);
  * @param ins The instruction to print the domains for.
  * @param inMap The incoming domains.
  * @param outMap The outgoing domains.
+ * @param os The stream to print to.
  */
 void printInstructionTransfer(const llvm::Instruction *ins, const FactMap& inMap,
-                              const FactMap& outMap);
+                              const FactMap& outMap, llvm::raw_ostream &os = llvm::outs());
+
+/**
+ * @brief Prints the facts of instructions in the format of
+ * printInstructionTransfer() into one buffer, which is written out whenever it
+ * grows past its capacity and when the writer is destroyed.
+ *
+ * The buffer and the scratch space for the printed facts are allocated once
+ * and reused for every instruction.
+ */
+class FactWriter {
+public:
+  /**
+   * @param capacity Size of the buffer, in bytes.
+   */
+  explicit FactWriter(llvm::raw_ostream &os, size_t capacity = 1 << 16);
+  ~FactWriter();
+  FactWriter(const FactWriter &) = delete;
+  FactWriter &operator=(const FactWriter &) = delete;
+
+  void write(const llvm::Instruction *ins, const FactMap &inMap, const FactMap &outMap);
+
+  /**
+   * @brief Same as the other write(), for an instruction printed as name.
+   */
+  void write(llvm::StringRef name, const FactMap &inMap, const FactMap &outMap);
+
+  /**
+   * @brief Writes out what is buffered.
+   */
+  void flush();
+
+private:
+  llvm::raw_ostream &_os;
+  size_t _capacity;
+  std::string _buffer;
+  llvm::raw_string_ostream _stream;
+  /// The printed domains of the In facts of the current instruction.
+  std::vector<std::string> _domains;
+};
 
 /**
  * @brief Print the In and Out memory of every instruction in function F to
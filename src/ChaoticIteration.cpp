@@ -1,7 +1,74 @@
-#include "OOBCheckerPass.h"
+#include "OOBChecker.h"
+#include "Timing.h"
+#include "Trace.h"
 #include "Utils.h"
+#include <llvm/ADT/PostOrderIterator.h>
+#include <llvm/ADT/Statistic.h>
+#include <llvm/IR/CFG.h>
+#include <chrono>
 #include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
+#define DEBUG_TYPE "oob-checker"
+
+STATISTIC(NumTransfers, "Number of transfer functions evaluated");
+STATISTIC(NumWorklistPushes, "Number of instructions pushed on the worklist");
+STATISTIC(NumJoins, "Number of joins of predecessor facts");
+STATISTIC(NumMapCopies, "Number of fact maps copied");
+STATISTIC(NumWidenings, "Number of loop head facts widened");
 namespace dataflow {
+    llvm::cl::opt<unsigned> TransferBudget(
+        "oob-max-transfers",
+        llvm::cl::desc("Transfer functions per instruction the fixpoint of a function may apply "
+                       "before its facts are widened to top (0 = no limit)"),
+        llvm::cl::init(OOBChecker::maxIterCnt));
+
+    llvm::cl::opt<unsigned> TimeBudget(
+        "oob-max-ms",
+        llvm::cl::desc("Milliseconds the fixpoint of a function may run before its facts are "
+                       "widened to top (0 = no limit)"),
+        llvm::cl::init(0));
+
+    /**
+     * @brief Sets every fact of every instruction to top.
+     */
+    static void widenToTop(AnalysisContext &context) {
+        for (auto *facts : {&context.in, &context.out}) {
+            for (auto &entry : *facts) {
+                for (auto &fact : entry.second) {
+                    fact.second = IntervalDomain::UNINIT();
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Returns the first instructions of the blocks that a retreating
+     * edge enters, in reverse post-order. Every cycle of the control-flow
+     * graph goes through one of them, so widening there ends every loop.
+     * Unreachable blocks are not ordered, so all of them count.
+     */
+    static std::unordered_set<const llvm::Instruction *> loopHeads(const llvm::Function &func) {
+        std::unordered_map<const llvm::BasicBlock *, size_t> order;
+        llvm::ReversePostOrderTraversal<const llvm::Function *> rpo(&func);
+        for (auto *blk : rpo) {
+            order.emplace(blk, order.size());
+        }
+        std::unordered_set<const llvm::Instruction *> ret;
+        for (auto &blk : func) {
+            auto pos = order.find(&blk);
+            for (auto *pred : llvm::predecessors(&blk)) {
+                auto predPos = order.find(pred);
+                if (pos == order.end() || predPos == order.end() || predPos->second >= pos->second) {
+                    ret.insert(&blk.front());
+                    break;
+                }
+            }
+        }
+        return ret;
+    }
+
     /**
      * @brief Get the Predecessors of a given instruction in the control-flow graph.
      *
@@ -53,32 +120,85 @@ namespace dataflow {
         return ret;
     }
 
-    void OOBCheckerPass::doAnalysis(const llvm::Function& func, AnalysisContext& context) {
+    void OOBChecker::doAnalysis(const llvm::Function& func, AnalysisContext& context) {
+        PhaseTimer timer(Phase::Fixpoint);
         std::queue<const llvm::Instruction*> insQueue;
         auto firstIns = &(*inst_begin(func));
+        // Values outside a non-empty slice are not tracked.
+        auto tracked = [&context](const llvm::Value *val) {
+            return context.slice.empty() || context.slice.count(val);
+        };
         for (auto iter = func.arg_begin(); iter != func.arg_end(); ++iter) {
             auto arg = &(*iter);
-            context.in[firstIns][variable(arg)] = IntervalDomain { arg };
-            context.pointerSet.insert(arg);
+            if (tracked(arg)) {
+                context.in[firstIns][variable(arg)] = context.args.getOrExtract(arg);
+                context.pointerSet.insert(arg);
+            }
         }
 
         for (auto iter = inst_begin(func); iter != inst_end(func); ++iter) {
             auto ins = &(*iter);
             insQueue.push(ins);
-            context.pointerSet.insert(ins);
+            ++NumWorklistPushes;
+            if (tracked(ins)) {
+                context.pointerSet.insert(ins);
+            }
+        }
+
+        std::unique_ptr<TraceRecorder> trace;
+        if (auto writer = TraceWriter::instance()) {
+            trace = std::make_unique<TraceRecorder>(*writer, func);
         }
 
-        for (int i = 0; !insQueue.empty() && i < maxIterCnt; ++i) {
+        // The clock is only read every so many transfers.
+        const unsigned clockInterval = 256;
+        // Loop heads join this many times before their facts are widened,
+        // so loops that settle on their own keep their bounds.
+        const unsigned widenDelay = 2;
+        auto heads = loopHeads(func);
+        std::unordered_map<const llvm::Instruction *, unsigned> joins;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TimeBudget);
+        // A fixpoint that converges visits each instruction a few times, so
+        // the budget grows with the function.
+        uint64_t budget = (uint64_t)TransferBudget * func.getInstructionCount();
+        for (uint64_t i = 0; !insQueue.empty(); ++i) {
+            if ((budget && i >= budget) ||
+                (TimeBudget && i % clockInterval == 0 && std::chrono::steady_clock::now() > deadline)) {
+                widenToTop(context);
+                context.degraded = true;
+                if (trace) {
+                    trace->finish(true);
+                }
+                return;
+            }
             auto ins = insQueue.front();
             insQueue.pop();
+            ++NumTransfers;
+            ++context.transfers;
 
+            bool widen = heads.count(ins) && ++joins[ins] > widenDelay;
+            FactMap before;
+            if (widen) {
+                before = context.in.at(ins);
+                ++NumMapCopies;
+            }
             for (auto predIns : getPredecessors(ins)) {
                 context.in.at(ins) += context.out.at(predIns);
+                ++NumJoins;
+            }
+            if (widen && context.in.at(ins) != before) {
+                context.in.at(ins) = before.widen(context.in.at(ins));
+                ++NumWidenings;
             }
             // gen set
-            auto gen = genSet(ins, context);
-            auto kill = killSet(ins, context);
+            FactMap gen;
+            std::unordered_set<std::string> kill;
+            if (tracked(ins)) {
+                gen = genSet(ins, context);
+                kill = killSet(ins, context);
+            }
             auto newOut = context.in.at(ins);
+            ++NumMapCopies;
             for (auto key : kill) {
                 if(newOut.contains(key)) {
                     newOut.erase(key);
@@ -88,10 +208,18 @@ namespace dataflow {
             if (newOut != context.out.at(ins)) {
                 for(auto succIns : getSuccessors(ins)) {
                     insQueue.emplace(succIns);
+                    ++NumWorklistPushes;
                 }
                 context.out.at(ins) = newOut;
+                ++NumMapCopies;
+            }
+            if (trace) {
+                trace->visit(ins, context.in.at(ins), context.out.at(ins));
             }
         }
+        if (trace) {
+            trace->finish(false);
+        }
     }
 
 } // namespace dataflow
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "ContextCache.h"
+#include "OOBChecker.h"
+#include "RangeQuery.h"
+
+namespace dataflow {
+
+llvm::cl::opt<unsigned> CallContexts(
+    "oob-contexts",
+    llvm::cl::desc("Re-analyze called functions under the constant arguments and array sizes of "
+                   "each call site, keeping at most this many contexts (0 = off)"),
+    llvm::cl::init(0));
+
+namespace {
+
+/**
+ * @brief Is val a single, finite constant?
+ */
+bool isExact(const IntervalDomain &val) {
+  return !val.isUnknown() && !val.isEmpty() && val.lower() == val.upper() &&
+         val.lower() != Interval::INT_NEG_INF && val.upper() != Interval::INT_INF;
+}
+
+} // namespace
+
+ContextCache::ContextCache(const PointerAnalysis &pa, const ObjectSizeAnalysis &sizes,
+                           const SummaryTable &summaries, size_t capacity)
+    : _pa(pa), _sizes(sizes), _summaries(summaries), _capacity(std::max<size_t>(capacity, 1)) {}
+
+std::unique_ptr<ContextCache> ContextCache::build(const PointerAnalysis &pa,
+                                                  const ObjectSizeAnalysis &sizes,
+                                                  const SummaryTable *summaries) {
+  if (!CallContexts || !summaries) {
+    return nullptr;
+  }
+  return std::make_unique<ContextCache>(pa, sizes, *summaries, CallContexts);
+}
+
+std::shared_ptr<const ContextResult> ContextCache::lookup(const llvm::CallInst *call,
+                                                          const FactMap &facts) {
+  auto *callee = call->getCalledFunction();
+  if (!callee || callee->isDeclaration() || !_summaries.find(callee)) {
+    return nullptr;
+  }
+  std::map<unsigned, IntervalDomain> args, argSizes;
+  std::string key;
+  llvm::raw_string_ostream os(key);
+  os << (const void *)callee;
+  for (unsigned i = 0; i < call->arg_size() && i < callee->arg_size(); ++i) {
+    auto *actual = call->getArgOperand(i);
+    auto val = actual->getType()->isPointerTy() ? _sizes.lookup(actual, facts)
+                                                : facts.getOrExtract(actual);
+    if (!isExact(val)) {
+      continue;
+    }
+    (actual->getType()->isPointerTy() ? argSizes : args)[i] = val;
+    os << (actual->getType()->isPointerTy() ? " size " : " arg ") << i << " " << val.lower();
+  }
+  if (args.empty() && argSizes.empty()) {
+    return nullptr;
+  }
+  os.flush();
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto iter = _index.find(key);
+    if (iter != _index.end()) {
+      _entries.splice(_entries.begin(), _entries, iter->second);
+      return iter->second->second;
+    }
+  }
+  // Analyzed without the lock; two threads may both analyze a new context.
+  auto ret = analyze(*callee, args, argSizes);
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (!_index.count(key)) {
+    _entries.emplace_front(key, ret);
+    _index[key] = _entries.begin();
+    if (_entries.size() > _capacity) {
+      _index.erase(_entries.back().first);
+      _entries.pop_back();
+    }
+  }
+  return ret;
+}
+
+std::shared_ptr<const ContextResult>
+ContextCache::analyze(const llvm::Function &callee, const std::map<unsigned, IntervalDomain> &args,
+                      const std::map<unsigned, IntervalDomain> &argSizes) {
+  NameScope names(callee);
+  ObjectSizeAnalysis sizes(_sizes, callee, argSizes);
+  FactMap argFacts;
+  for (auto &arg : callee.args()) {
+    auto iter = args.find(arg.getArgNo());
+    if (iter != args.end()) {
+      argFacts[variable(&arg)] = iter->second;
+    }
+  }
+
+  auto ret = std::make_shared<ContextResult>();
+  AnalysisContext summarized{_pa, sizes};
+  summarized.summaries = &_summaries;
+  summarized.args = argFacts;
+  ret->summary = SummaryTable::summarize(callee, summarized);
+
+  // Accesses with constant indices do not depend on the context, they are
+  // reported with the callee itself.
+  if (OOBChecker::triage(callee, sizes) != Triage::NeedsDataflow) {
+    return ret;
+  }
+  AnalysisContext checked{_pa, sizes};
+  checked.summaries = &_summaries;
+  checked.args = argFacts;
+  OOBChecker checker;
+  if (TieredAnalysis) {
+    checker.analyzeTiered(callee, checked);
+  } else {
+    checker.analyze(callee, checked);
+  }
+  for (auto *ins : checker.findErrors(callee, checked)) {
+    ret->errors.push_back(OOBChecker::diagnose(ins, checked));
+  }
+  return ret;
+}
+
+void ContextCache::specialize(const llvm::Function &func, AnalysisContext &context) {
+  // The facts of a degraded fixpoint were thrown away for top.
+  if (context.degraded) {
+    context.specialized.clear();
+    return;
+  }
+  RangeQuery query(func, context);
+  // Values the fixpoint did not track, or all of them if it did not run,
+  // come from the query.
+  auto fact = [&context, &query](const llvm::Value *val, const llvm::Instruction *ins) {
+    auto iter = context.in.find(ins);
+    if (iter != context.in.end() && iter->second.contains(variable(val))) {
+      return iter->second.getOrExtract(val);
+    }
+    IntervalDomain ret;
+    if (query.tryQuery(val, ins, ret)) {
+      return ret;
+    }
+    return IntervalDomain{val};
+  };
+  for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter) {
+    auto *call = llvm::dyn_cast<llvm::CallInst>(&*iter);
+    if (!call || !_summaries.find(call) || context.specialized.count(call)) {
+      continue;
+    }
+    FactMap facts;
+    for (auto &arg : call->args()) {
+      const llvm::Value *val = arg;
+      if (val->getType()->isPointerTy()) {
+        auto *size = _sizes.find(val);
+        val = size && size->isSymbolic() ? size->symbol : nullptr;
+      }
+      if (val && (llvm::isa<llvm::Instruction>(val) || llvm::isa<llvm::Argument>(val))) {
+        facts[variable(val)] = fact(val, call);
+      }
+    }
+    if (auto result = lookup(call, facts)) {
+      context.specialized[call] = result;
+    }
+  }
+}
+
+} // namespace dataflow
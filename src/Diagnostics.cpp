@@ -0,0 +1,125 @@
+#include "Diagnostics.h"
+
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/Path.h>
+
+namespace dataflow {
+
+llvm::cl::opt<std::string> DiagnosticsFile(
+    "oob-diagnostics",
+    llvm::cl::desc("Also write every error as one line of JSON to this file ('-' for stdout), "
+                   "as soon as its function is checked"),
+    llvm::cl::value_desc("filename"));
+
+namespace {
+
+llvm::json::Value text(llvm::StringRef str) {
+  return llvm::json::isUTF8(str) ? str.str() : llvm::json::fixUTF8(str);
+}
+
+/**
+ * @brief Writes domain as a list of [lower, upper] pairs, with null for an
+ * infinite bound, or null if it is unknown.
+ */
+llvm::json::Value intervals(const IntervalDomain &domain) {
+  if (domain.isUnknown()) {
+    return nullptr;
+  }
+  auto bound = [](int val) -> llvm::json::Value {
+    if (val == Interval::INT_NEG_INF || val == Interval::INT_INF) {
+      return nullptr;
+    }
+    return val;
+  };
+  llvm::json::Array ret;
+  for (auto &interval : domain) {
+    ret.push_back(llvm::json::Array{bound(interval.lower()), bound(interval.upper())});
+  }
+  return std::move(ret);
+}
+
+/**
+ * @brief Fills the source location of ins into file, line and column.
+ */
+void locate(const llvm::Instruction *ins, std::string &file, unsigned &line, unsigned &column) {
+  auto *loc = ins->getDebugLoc().get();
+  if (!loc) {
+    file = ins->getModule()->getSourceFileName();
+    line = column = 0;
+    return;
+  }
+  llvm::SmallString<128> path(loc->getDirectory());
+  if (path.empty() || llvm::sys::path::is_absolute(loc->getFilename())) {
+    path = loc->getFilename();
+  } else {
+    llvm::sys::path::append(path, loc->getFilename());
+  }
+  file = path.str().str();
+  line = loc->getLine();
+  column = loc->getColumn();
+}
+
+} // namespace
+
+Diagnostic::Diagnostic(const llvm::Instruction *ins, const IntervalDomain &index,
+                       const IntervalDomain &size)
+    : function(ins->getFunction()->getName().str()), index(index), size(size) {
+  locate(ins, file, line, column);
+  llvm::raw_string_ostream os(instruction);
+  os << *ins;
+}
+
+void Diagnostic::write(llvm::raw_ostream &os, const llvm::CallInst *via) const {
+  llvm::json::Object record{
+      {"file", text(file)},
+      {"line", (int64_t)line},
+      {"column", (int64_t)column},
+      {"function", text(function)},
+      {"instruction", text(llvm::StringRef(instruction).trim())},
+      {"index", intervals(index)},
+      {"size", intervals(size)},
+  };
+  if (via) {
+    Diagnostic call(via, IntervalDomain::UNINIT(), IntervalDomain::UNINIT());
+    record["via"] = llvm::json::Object{
+        {"file", text(call.file)},
+        {"line", (int64_t)call.line},
+        {"column", (int64_t)call.column},
+        {"function", text(call.function)},
+        {"instruction", text(llvm::StringRef(call.instruction).trim())},
+    };
+  }
+  os << llvm::json::Value(std::move(record)) << "\n";
+}
+
+DiagnosticStream::DiagnosticStream(std::unique_ptr<llvm::raw_fd_ostream> os) : _os(std::move(os)) {
+  // One write per batch of records, so that forked workers writing to the
+  // same file do not interleave their lines.
+  _os->SetUnbuffered();
+}
+
+std::unique_ptr<DiagnosticStream> DiagnosticStream::open() {
+  if (DiagnosticsFile.empty()) {
+    return nullptr;
+  }
+  std::error_code error;
+  auto os = std::make_unique<llvm::raw_fd_ostream>(DiagnosticsFile, error);
+  if (error) {
+    llvm::errs() << "Cannot write the diagnostics " << DiagnosticsFile << ": " << error.message()
+                 << "\n";
+    return nullptr;
+  }
+  return std::make_unique<DiagnosticStream>(std::move(os));
+}
+
+void DiagnosticStream::write(llvm::StringRef records) {
+  if (records.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  _os->write(records.data(), records.size());
+}
+
+} // namespace dataflow
@@ -8,6 +8,11 @@
 #include <llvm/IR/Argument.h>
 #include <llvm/IR/Instruction.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/ADT/Statistic.h>
+
+#define DEBUG_TYPE "interval-domain"
+
+STATISTIC(NumMerges, "Number of overlapping intervals merged");
 
 #endif
 
@@ -85,6 +90,9 @@ void IntervalDomain::maintain() {
       auto &last = newInterval.back();
       if (last.overlaps(interval)) {
         last |= interval;
+#ifndef UNIT_TEST
+        ++NumMerges;
+#endif
       } else {
         newInterval.push_back(interval);
       }
@@ -134,6 +142,25 @@ void IntervalDomain::clamp(int lo, int hi) {
   maintain();
 }
 
+void IntervalDomain::insert(const Interval &interval) {
+  if (_unknown) return;
+  _intervals.push_back(interval);
+  maintain();
+}
+
+void IntervalDomain::widen(const IntervalDomain &next) {
+  if (_unknown) return;
+  if (next._unknown || _intervals.empty()) {
+    *this = next;
+    return;
+  }
+  if (next._intervals.empty() || (*this | next) == *this) return;
+  int lo = next.lower() < lower() ? Interval::INT_NEG_INF : lower();
+  int hi = next.upper() > upper() ? Interval::INT_INF : upper();
+  // One interval, so the gaps between intervals cannot fill up one by one.
+  *this = IntervalDomain(lo, hi);
+}
+
 bool IntervalDomain::operator==(const IntervalDomain &other) const {
   if (_unknown ^ other._unknown) return false;
   return (_unknown && other._unknown) || _intervals == other._intervals;
@@ -1,8 +1,11 @@
 #include "FactMap.h"
+#ifndef UNIT_TEST
 #include "Utils.h"
+#endif
 
 namespace dataflow {
 
+#ifndef UNIT_TEST
 FactMap::DomainType FactMap::getOrExtract(const llvm::Value *val) const {
   auto key = variable(val);
   if (contains(key)) {
@@ -11,6 +14,7 @@ FactMap::DomainType FactMap::getOrExtract(const llvm::Value *val) const {
     return IntervalDomain { val };
   }
 }
+#endif
 FactMap& FactMap::operator+=(const FactMap& other) {
     for (auto kvp : other) {
         if (!contains(kvp.first)) {
@@ -21,6 +25,16 @@ FactMap& FactMap::operator+=(const FactMap& other) {
     }
     return *this;
 }
+FactMap& FactMap::widen(const FactMap& next) {
+    for (auto& kvp : next) {
+        if (!contains(kvp.first)) {
+            operator[](kvp.first) = kvp.second;
+        } else {
+            operator[](kvp.first).widen(kvp.second);
+        }
+    }
+    return *this;
+}
 bool FactMap::operator==(const FactMap& other) const {
     auto cmpOne = [](const FactMap& a, const FactMap& b) {
         for (auto kvp : a) {
@@ -0,0 +1,193 @@
+#include "FunctionSummary.h"
+#include "OOBChecker.h"
+#include "ParallelDriver.h"
+#include "RangeQuery.h"
+#include "Timing.h"
+
+#include <llvm/ADT/SCCIterator.h>
+#include <llvm/Analysis/CallGraph.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/ThreadPool.h>
+#include <algorithm>
+#include <vector>
+
+namespace dataflow {
+
+llvm::cl::opt<bool> UseSummaries(
+    "oob-summaries",
+    llvm::cl::desc("Use the return ranges and stores of the called functions at call sites"),
+    llvm::cl::init(true));
+
+namespace {
+
+/**
+ * @brief Joins val into the fact of key, which is bottom if missing.
+ */
+void joinInto(std::map<unsigned, IntervalDomain> &facts, unsigned key, const IntervalDomain &val) {
+  auto iter = facts.find(key);
+  if (iter == facts.end()) {
+    facts.emplace(key, val);
+  } else {
+    iter->second |= val;
+  }
+}
+
+} // namespace
+
+SummaryTable::SummaryTable(llvm::Module &module, const PointerAnalysis &pa,
+                           const ObjectSizeAnalysis &sizes, unsigned jobs) {
+  // A component only calls components of lower levels, so the components of
+  // one level can be summarized together once the levels below are done.
+  llvm::CallGraph graph(module);
+  std::unordered_map<const llvm::Function *, unsigned> levels;
+  std::vector<std::vector<std::vector<const llvm::Function *>>> components;
+  for (auto &func : module) {
+    if (func.isDeclaration() || levels.count(&func)) {
+      continue;
+    }
+    // Starting from every function also reaches the ones nobody calls; the
+    // components found before are skipped.
+    for (auto scc = llvm::scc_begin(graph[&func]); !scc.isAtEnd(); ++scc) {
+      std::vector<const llvm::Function *> members;
+      for (auto *node : *scc) {
+        auto *member = node->getFunction();
+        if (member && !member->isDeclaration() && !levels.count(member)) {
+          members.push_back(member);
+        }
+      }
+      if (members.empty()) {
+        continue;
+      }
+      unsigned level = 0;
+      for (auto *node : *scc) {
+        for (auto &record : *node) {
+          auto *callee = record.second->getFunction();
+          auto iter = callee ? levels.find(callee) : levels.end();
+          if (iter != levels.end()) {
+            level = std::max(level, iter->second + 1);
+          }
+        }
+      }
+      for (auto *member : members) {
+        levels[member] = level;
+        _summaries[member] = nullptr;
+      }
+      components.resize(std::max<size_t>(components.size(), level + 1));
+      components[level].push_back(std::move(members));
+    }
+  }
+
+#if LLVM_VERSION_MAJOR >= 11
+  llvm::ThreadPool pool(llvm::hardware_concurrency(jobs));
+#else
+  llvm::ThreadPool pool(jobs ? jobs : llvm::hardware_concurrency());
+#endif
+  for (auto &level : components) {
+    for (auto &members : level) {
+      pool.async([this, &members, &pa, &sizes] {
+        // In turn: the later members see the summaries of the earlier ones.
+        for (auto *member : members) {
+          NameScope names(*member);
+          AnalysisContext context{pa, sizes};
+          context.summaries = this;
+          auto summary = std::make_unique<FunctionSummary>(summarize(*member, context));
+          _summaries.find(member)->second = std::move(summary);
+        }
+      });
+    }
+    pool.wait();
+  }
+}
+
+std::unique_ptr<SummaryTable> SummaryTable::build(llvm::Module &module, const PointerAnalysis &pa,
+                                                  const ObjectSizeAnalysis &sizes) {
+  return build(module, pa, sizes, Jobs);
+}
+
+std::unique_ptr<SummaryTable> SummaryTable::build(llvm::Module &module, const PointerAnalysis &pa,
+                                                  const ObjectSizeAnalysis &sizes, unsigned jobs) {
+  if (!UseSummaries) {
+    return nullptr;
+  }
+  PhaseTimer timer(Phase::Summaries);
+  return std::make_unique<SummaryTable>(module, pa, sizes, jobs);
+}
+
+const FunctionSummary *SummaryTable::find(const llvm::Function *func) const {
+  auto iter = _summaries.find(func);
+  return iter == _summaries.end() ? nullptr : iter->second.get();
+}
+
+const FunctionSummary *SummaryTable::find(const llvm::CallInst *call) const {
+  auto *callee = call->getCalledFunction();
+  return callee ? find(callee) : nullptr;
+}
+
+bool FunctionSummary::written(const llvm::CallInst *call, const llvm::Value *ptr, bool aliases,
+                              const PointerAnalysis &pa, IntervalDomain &ret) const {
+  bool found = false;
+  for (auto &write : writes) {
+    if (write.first >= call->arg_size()) {
+      continue;
+    }
+    auto *actual = call->getArgOperand(write.first);
+    if (actual != ptr && !(aliases && pa.alias(actual, ptr))) {
+      continue;
+    }
+    if (found) {
+      ret |= write.second;
+    } else {
+      ret = write.second;
+      found = true;
+    }
+  }
+  return found;
+}
+
+bool SummaryTable::written(const llvm::CallInst *call, const llvm::Value *ptr, bool aliases,
+                           const PointerAnalysis &pa, IntervalDomain &ret) const {
+  auto *summary = find(call);
+  return summary && summary->written(call, ptr, aliases, pa, ret);
+}
+
+FunctionSummary SummaryTable::summarize(const llvm::Function &func, AnalysisContext &context) {
+  auto &pa = context.pa;
+  RangeQuery query(func, context);
+
+  FunctionSummary ret;
+  bool returns = false;
+  for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter) {
+    auto *ins = &*iter;
+    if (auto *retIns = llvm::dyn_cast<llvm::ReturnInst>(ins)) {
+      auto *val = retIns->getReturnValue();
+      if (val && val->getType()->isIntegerTy()) {
+        auto range = query.queryRange(val, retIns);
+        ret.ret = returns ? ret.ret | range : range;
+        returns = true;
+      }
+    } else if (auto *store = llvm::dyn_cast<llvm::StoreInst>(ins)) {
+      auto *target = store->getPointerOperand();
+      auto *val = store->getValueOperand();
+      if (val->getType()->isPointerTy()) {
+        continue;
+      }
+      for (auto &arg : func.args()) {
+        if (arg.getType()->isPointerTy() && (target == &arg || pa.alias(target, &arg))) {
+          joinInto(ret.writes, arg.getArgNo(), query.queryRange(val, store));
+        }
+      }
+    } else if (auto *call = llvm::dyn_cast<llvm::CallInst>(ins)) {
+      // What the callee stores through our arguments, we store too.
+      for (auto &arg : func.args()) {
+        IntervalDomain val;
+        if (arg.getType()->isPointerTy() && context.summaries &&
+            context.summaries->written(call, &arg, true, pa, val)) {
+          joinInto(ret.writes, arg.getArgNo(), val);
+        }
+      }
+    }
+  }
+  return ret;
+}
+
+} // namespace dataflow
@@ -7,6 +7,16 @@
 #endif
 
 namespace dataflow {
+/**
+ * @brief Clamp a 64-bit result into [INT_NEG_INF, INT_INF], so that
+ * unbounded operands stay unbounded instead of wrapping around.
+ */
+static int saturate(long long val) {
+  if (val <= Interval::INT_NEG_INF) return Interval::INT_NEG_INF;
+  if (val >= Interval::INT_INF) return Interval::INT_INF;
+  return static_cast<int>(val);
+}
+
 void Interval::cut(const Interval &other) {
   if (!overlaps(other)) return;
   if (lo <= other.lo) {
@@ -31,19 +41,21 @@ Interval& Interval::operator|=(const Interval& other) {
 }
 
 Interval& Interval::operator+=(const Interval &other) {
-  lo += other.lo;
-  hi += other.hi;
+  lo = (lo == INT_NEG_INF || other.lo == INT_NEG_INF) ? INT_NEG_INF : saturate((long long)lo + other.lo);
+  hi = (hi == INT_INF || other.hi == INT_INF) ? INT_INF : saturate((long long)hi + other.hi);
   return *this;
 }
 Interval& Interval::operator-=(const Interval &other) {
-  lo -= other.hi;
-  hi -= other.lo;
+  auto newLo = (lo == INT_NEG_INF || other.hi == INT_INF) ? INT_NEG_INF : saturate((long long)lo - other.hi);
+  hi = (hi == INT_INF || other.lo == INT_NEG_INF) ? INT_INF : saturate((long long)hi - other.lo);
+  lo = newLo;
   return *this;
 }
 Interval& Interval::operator*=(const Interval &other) {
-  auto it = std::minmax({lo * other.lo, lo * other.hi, hi * other.lo, hi * other.hi});
-  lo = it.first;
-  hi = it.second;
+  auto it = std::minmax({(long long)lo * other.lo, (long long)lo * other.hi,
+                         (long long)hi * other.lo, (long long)hi * other.hi});
+  lo = saturate(it.first);
+  hi = saturate(it.second);
   return *this;
 }
 Interval& Interval::operator/=(const Interval &other) {
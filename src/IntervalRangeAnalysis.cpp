@@ -0,0 +1,89 @@
+#include "IntervalRangeAnalysis.h"
+
+namespace dataflow {
+
+llvm::AnalysisKey OOBModuleAnalysis::Key;
+llvm::AnalysisKey OOBModuleRegistry::Key;
+llvm::AnalysisKey IntervalRangeAnalysis::Key;
+
+OOBModuleAnalysis::Result OOBModuleAnalysis::run(llvm::Module &module,
+                                                 llvm::ModuleAnalysisManager &manager) {
+  Result ret;
+  ret.facts = std::make_shared<ModuleFacts>();
+  auto &facts = *ret.facts;
+  facts.pa = std::make_unique<PointerAnalysis>(module, DemandDrivenPA);
+  facts.sizes = std::make_unique<ObjectSizeAnalysis>(module, *facts.pa);
+  facts.summaries = SummaryTable::build(module, *facts.pa, *facts.sizes);
+  facts.contexts = ContextCache::build(*facts.pa, *facts.sizes, facts.summaries.get());
+  manager.getResult<OOBModuleRegistry>(module).facts = ret.facts;
+  return ret;
+}
+
+bool OOBModuleAnalysis::Result::invalidate(llvm::Module &, const llvm::PreservedAnalyses &preserved,
+                                          llvm::ModuleAnalysisManager::Invalidator &) {
+  auto checker = preserved.getChecker<OOBModuleAnalysis>();
+  return !checker.preserved() && !checker.preservedSet<llvm::AllAnalysesOn<llvm::Module>>();
+}
+
+IntervalRangeAnalysis::Result::Result(const llvm::Function &func,
+                                      std::unique_ptr<PointerAnalysis> pa,
+                                      std::unique_ptr<ObjectSizeAnalysis> sizes)
+    : _func(&func), _pa(std::move(pa)), _sizes(std::move(sizes)),
+      _context(new AnalysisContext{*_pa, *_sizes}),
+      _query(std::make_unique<RangeQuery>(func, *_context)) {}
+
+IntervalRangeAnalysis::Result::Result(const llvm::Function &func,
+                                      std::shared_ptr<ModuleFacts> module)
+    : _func(&func), _module(std::move(module)),
+      _context(new AnalysisContext{*_module->pa, *_module->sizes}),
+      _query(std::make_unique<RangeQuery>(func, *_context)) {
+  _context->summaries = _module->summaries.get();
+  _context->contexts = _module->contexts.get();
+}
+
+bool IntervalRangeAnalysis::Result::invalidate(llvm::Function &, const llvm::PreservedAnalyses &preserved,
+                                               llvm::FunctionAnalysisManager::Invalidator &) {
+  auto checker = preserved.getChecker<IntervalRangeAnalysis>();
+  return !checker.preserved() && !checker.preservedSet<llvm::AllAnalysesOn<llvm::Function>>();
+}
+
+IntervalDomain IntervalRangeAnalysis::Result::rangeAt(const llvm::Value *val,
+                                                      const llvm::Instruction *ins) const {
+  return _query->queryRange(val, ins);
+}
+
+IntervalDomain IntervalRangeAnalysis::Result::sizeAt(const llvm::Value *ptr,
+                                                     const llvm::Instruction *ins) const {
+  return _query->querySize(ptr, ins);
+}
+
+AnalysisContext &IntervalRangeAnalysis::Result::context() {
+  return const_cast<AnalysisContext &>(static_cast<const Result *>(this)->context());
+}
+
+const AnalysisContext &IntervalRangeAnalysis::Result::context() const {
+  _query->analyzeAll();
+  if (_context->contexts) {
+    _context->contexts->specialize(*_func, *_context);
+  }
+  return *_context;
+}
+
+IntervalRangeAnalysis::Result IntervalRangeAnalysis::run(llvm::Function &func,
+                                                         llvm::FunctionAnalysisManager &manager) {
+  auto &proxy = manager.getResult<llvm::ModuleAnalysisManagerFunctionProxy>(func);
+  auto registry = proxy.getCachedResult<OOBModuleRegistry>(*func.getParent());
+  if (auto module = registry ? registry->facts.lock() : nullptr) {
+    // Facts computed against the module result go stale with it.
+    proxy.registerOuterAnalysisInvalidation<OOBModuleAnalysis, IntervalRangeAnalysis>();
+    return Result(func, std::move(module));
+  }
+  // A function analysis cannot compute module analyses itself, so without a
+  // cached module result fall back to points-to facts and sizes local to
+  // func, which cost no more than func itself.
+  auto pa = std::make_unique<PointerAnalysis>(func, DemandDrivenPA);
+  auto sizes = std::make_unique<ObjectSizeAnalysis>(func, *pa);
+  return Result(func, std::move(pa), std::move(sizes));
+}
+
+} // namespace dataflow
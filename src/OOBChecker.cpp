@@ -0,0 +1,326 @@
+#include "OOBChecker.h"
+#include "ContextCache.h"
+#include "ResultCache.h"
+#include "Snapshot.h"
+#include "Timing.h"
+#include "Utils.h"
+
+namespace dataflow
+{
+  llvm::cl::opt<bool> DemandDrivenPA(
+      "oob-demand-pa",
+      llvm::cl::desc("Only solve points-to facts for pointers that can reach an array access"),
+      llvm::cl::init(true));
+
+  llvm::cl::opt<bool> TriageFunctions(
+      "oob-triage",
+      llvm::cl::desc("Skip the interval analysis for functions without arrays or whose accesses "
+                     "all have constant indices"),
+      llvm::cl::init(true));
+
+  void TriageCounts::add(const TriageCounts &other)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      counts[i] += other.counts[i].load();
+    }
+  }
+
+  void TriageCounts::print(llvm::raw_ostream &os) const
+  {
+    os << "Triage: " << counts[(int)Triage::NoArrays] << " functions without arrays, "
+       << counts[(int)Triage::ConstantOnly] << " with constant indices only, "
+       << counts[(int)Triage::NeedsDataflow] << " analyzed\n";
+  }
+
+  /**
+   * The index check() looks at: gep T* ptr, idx  or  gep [N x T]* ptr, 0, idx
+   */
+  static const llvm::Value *checkedIndex(const llvm::GetElementPtrInst *gep)
+  {
+    return (gep->getNumIndices() == 1 ? gep->idx_begin() : gep->idx_begin() + 1)->get();
+  }
+
+  Triage OOBChecker::triage(const llvm::Function &func, const ObjectSizeAnalysis &sizes)
+  {
+    if (!TriageFunctions)
+    {
+      return Triage::NeedsDataflow;
+    }
+    auto ret = Triage::NoArrays;
+    for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter)
+    {
+      auto *gep = llvm::dyn_cast<llvm::GetElementPtrInst>(&*iter);
+      if (!gep)
+      {
+        continue;
+      }
+      ret = Triage::ConstantOnly;
+      auto *index = checkedIndex(gep);
+      auto *size = sizes.find(gep->getPointerOperand());
+      if (!llvm::isa<llvm::ConstantInt>(index))
+      {
+        // check() ignores variable indices into nested arrays.
+        if (gep->getNumIndices() <= 2)
+        {
+          return Triage::NeedsDataflow;
+        }
+      }
+      else if (size && size->isSymbolic())
+      {
+        return Triage::NeedsDataflow;
+      }
+    }
+    return ret;
+  }
+
+  bool OOBChecker::reportWithoutDataflow(const llvm::Function &func,
+                                         const ObjectSizeAnalysis &sizes, llvm::raw_ostream &err)
+  {
+    PhaseTimer timer(Phase::Checking);
+    auto kind = triage(func, sizes);
+    triaged.add(kind);
+    if (kind == Triage::NeedsDataflow)
+    {
+      return false;
+    }
+    FactMap noFacts;
+    std::string records;
+    llvm::raw_string_ostream recordStream(records);
+    for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter)
+    {
+      if (check(&*iter, noFacts, sizes))
+      {
+        err << errorMessage << *iter << "\n";
+        if (diagnostics)
+        {
+          diagnose(&*iter, noFacts, sizes).write(recordStream);
+        }
+      }
+    }
+    if (diagnostics)
+    {
+      diagnostics->write(recordStream.str());
+    }
+    return true;
+  }
+
+  /**
+   * The facts check() looks at for ins: those of the tiers if they decided
+   * it, else those of the fixpoint.
+   */
+  static const FactMap &factsBefore(const llvm::Instruction *ins, const AnalysisContext &context)
+  {
+    return context.resolved.count(ins) ? context.constants : context.in.at(ins);
+  }
+
+  bool OOBChecker::check(const llvm::Instruction *ins, const AnalysisContext &context)
+  {
+    if (context.resolved.count(ins))
+    {
+      return check(ins, context.constants, context.sizes);
+    }
+    if (!llvm::isa<llvm::GetElementPtrInst>(ins))
+    {
+      return false;
+    }
+    return check(ins, context.in.at(ins), context.sizes);
+  }
+
+  bool OOBChecker::check(const llvm::Instruction *ins, const FactMap &inFacts,
+                         const ObjectSizeAnalysis &sizes)
+  {
+    if (auto *gep = llvm::dyn_cast<llvm::GetElementPtrInst>(ins))
+    {
+      auto *index = checkedIndex(gep);
+      if (gep->getNumIndices() > 2 && !llvm::isa<llvm::ConstantInt>(index))
+      {
+        return false;
+      }
+      auto arraySize = sizes.lookup(gep->getPointerOperand(), inFacts);
+      auto accessIndex = inFacts.getOrExtract(index);
+      // Out of bounds as soon as the index can reach the smallest size.
+      if (accessIndex.lower() < 0 || accessIndex.upper() >= arraySize.lower())
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  Diagnostic OOBChecker::diagnose(const llvm::Instruction *ins, const AnalysisContext &context)
+  {
+    return diagnose(ins, factsBefore(ins, context), context.sizes);
+  }
+
+  Diagnostic OOBChecker::diagnose(const llvm::Instruction *ins, const FactMap &inFacts,
+                                  const ObjectSizeAnalysis &sizes)
+  {
+    auto *gep = llvm::cast<llvm::GetElementPtrInst>(ins);
+    return Diagnostic(ins, inFacts.getOrExtract(checkedIndex(gep)),
+                      sizes.lookup(gep->getPointerOperand(), inFacts));
+  }
+
+  void OOBChecker::analyze(const llvm::Function &func, AnalysisContext &context)
+  {
+    // Initializing InMap and OutMap.
+    for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter)
+    {
+      auto ins = &(*iter);
+      context.in[ins] = {};
+      context.out[ins] = {};
+    }
+
+    // The chaotic iteration algorithm is implemented inside doAnalysis().
+    doAnalysis(func, context);
+  }
+
+  std::vector<const llvm::Instruction *> OOBChecker::findErrors(const llvm::Function &func,
+                                                                const AnalysisContext &context)
+  {
+    PhaseTimer timer(Phase::Checking);
+    std::vector<const llvm::Instruction *> ret;
+    for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter)
+    {
+      if (check(&*iter, context))
+      {
+        ret.push_back(&*iter);
+      }
+    }
+    return ret;
+  }
+
+  void OOBChecker::report(const llvm::Function &func, const AnalysisContext &context,
+                          llvm::raw_ostream &out, llvm::raw_ostream &err)
+  {
+    std::string records;
+    report(func, context, out, err, records);
+    if (diagnostics)
+    {
+      diagnostics->write(records);
+    }
+  }
+
+  void OOBChecker::report(const llvm::Function &func, const AnalysisContext &context,
+                          llvm::raw_ostream &out, llvm::raw_ostream &err, std::string &records)
+  {
+    llvm::raw_string_ostream recordStream(records);
+    if (context.degraded)
+    {
+      err << degradedMessage << func.getName() << "\n";
+    }
+    // Check each instruction in function F for potential out of bounds error.
+    for (auto ins : findErrors(func, context))
+    {
+      err << errorMessage << *ins << "\n";
+      if (diagnostics)
+      {
+        diagnose(ins, context).write(recordStream);
+      }
+    }
+    for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter)
+    {
+      auto *call = llvm::dyn_cast<llvm::CallInst>(&*iter);
+      if (!call || !context.specialized.count(call))
+      {
+        continue;
+      }
+      for (auto &error : context.specialized.at(call)->errors)
+      {
+        err << errorMessage << error.instruction << " via" << *call << "\n";
+        if (diagnostics)
+        {
+          error.write(recordStream, call);
+        }
+      }
+    }
+    recordStream.flush();
+    if (snapshot)
+    {
+      snapshot->add(func, context);
+    }
+
+    if (context.in.empty() || !dumpsFacts(func))
+    {
+      return;
+    }
+    PhaseTimer timer(Phase::Printing);
+    FactWriter writer(out);
+    for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter)
+    {
+      auto ins = &*iter;
+      writer.write(ins, context.in.at(ins), context.out.at(ins));
+    }
+  }
+
+  void OOBChecker::analyzeSelected(const llvm::Function &func, AnalysisContext &context)
+  {
+    if (TieredAnalysis)
+    {
+      analyzeTiered(func, context);
+    }
+    else
+    {
+      analyze(func, context);
+    }
+    if (context.contexts)
+    {
+      context.contexts->specialize(func, context);
+    }
+  }
+
+  void OOBChecker::analyzeAndReport(const llvm::Function &func, const PointerAnalysis &pa,
+                                    const ObjectSizeAnalysis &sizes,
+                                    llvm::raw_ostream &out, llvm::raw_ostream &err)
+  {
+    NameScope names(func);
+    if (reportWithoutDataflow(func, sizes, err))
+    {
+      return;
+    }
+    std::unique_ptr<AnalysisContext> context;
+    reportCached(func, pa, sizes, [&]() -> const AnalysisContext &
+                 {
+                   context.reset(new AnalysisContext{pa, sizes});
+                   context->summaries = summaries;
+                   context->contexts = contexts;
+                   analyzeSelected(func, *context);
+                   return *context;
+                 },
+                 out, err);
+  }
+
+  void OOBChecker::reportCached(const llvm::Function &func, const PointerAnalysis &pa,
+                                const ObjectSizeAnalysis &sizes,
+                                llvm::function_ref<const AnalysisContext &()> analyzed,
+                                llvm::raw_ostream &out, llvm::raw_ostream &err)
+  {
+    if (!cache || snapshot)
+    {
+      report(func, analyzed(), out, err);
+      return;
+    }
+
+    auto key = ResultCache::key(func, pa, sizes, summaries);
+    std::string outBuffer, errBuffer, records;
+    if (!cache->lookup(key, outBuffer, errBuffer, records))
+    {
+      auto &context = analyzed();
+      llvm::raw_string_ostream outStream(outBuffer), errStream(errBuffer);
+      report(func, context, outStream, errStream, records);
+      outStream.flush();
+      errStream.flush();
+      // Running out of time depends on the machine, not on the function.
+      if (!context.degraded || !TimeBudget)
+      {
+        cache->insert(key, outBuffer, errBuffer, records);
+      }
+    }
+    out << outBuffer;
+    err << errBuffer;
+    if (diagnostics)
+    {
+      diagnostics->write(records);
+    }
+  }
+} // namespace dataflow
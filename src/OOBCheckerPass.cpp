@@ -1,48 +1,83 @@
 #include "OOBCheckerPass.h"
+#include "Timing.h"
 #include "Utils.h"
 
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Passes/PassPlugin.h>
+
 namespace dataflow
 {
+  bool OOBCheckerPass::doInitialization(llvm::Module &module)
+  {
+    modulePA = std::make_unique<PointerAnalysis>(module, DemandDrivenPA);
+    moduleSizes = std::make_unique<ObjectSizeAnalysis>(module, *modulePA);
+    moduleSummaries = SummaryTable::build(module, *modulePA, *moduleSizes);
+    summaries = moduleSummaries.get();
+    moduleContexts = ContextCache::build(*modulePA, *moduleSizes, summaries);
+    contexts = moduleContexts.get();
+    if (!CacheFile.empty())
+    {
+      resultCache = std::make_unique<ResultCache>(CacheFile);
+      cache = resultCache.get();
+    }
+    diagnosticStream = DiagnosticStream::open();
+    diagnostics = diagnosticStream.get();
+    snapshotWriter = SnapshotWriter::open();
+    if (snapshotWriter)
+    {
+      snapshotWriter->addModule(module, *modulePA, *moduleSizes);
+    }
+    snapshot = snapshotWriter.get();
+    return false;
+  }
 
-  bool OOBCheckerPass::check(llvm::Instruction *ins, const AnalysisContext &context)
+  /**
+   * Writes the new reports back to the cache file.
+   */
+  static void saveCache(ResultCache &cache)
   {
-    if (auto *gep = llvm::dyn_cast<llvm::GetElementPtrInst>(ins))
+    if (!cache.save())
     {
-      const auto arrayPtr = gep->getPointerOperand();
-      auto *index = gep->idx_begin() + 1;
-      int arraySize = context.arraySizeMap.at(arrayPtr);
-      if (auto *constIndex = llvm::dyn_cast<llvm::ConstantInt>(index))
-      {
-        int val = constIndex->getSExtValue();
-        if (constIndex->getSExtValue() < 0 || constIndex->getSExtValue() >= arraySize)
-        {
-          return true;
-        }
-      }
-      else
-      {
-        llvm::Type *elementType = gep->getResultElementType();
-        int numOp = gep->getNumOperands();
-        if (gep->getNumOperands() == 3)
-        {
-          llvm::Value *idxProm = *(gep->idx_begin() + 1);
-          auto accessIndex = context.in.at(ins).getOrExtract(idxProm);
-          if (accessIndex.lower() < 0 || accessIndex.upper() >= arraySize)
-          {
-            return true;
-          }
-        }
-        else if (gep->getNumOperands() == 2)
-        {
-          llvm::Value *idxProm = *(gep->idx_begin());
-          auto accessIndex = context.in.at(ins).getOrExtract(idxProm);
-          if (accessIndex.lower() < 0 || accessIndex.upper() >= arraySize)
-          {
-            return true;
-          }
-        }
-      }
+      llvm::errs() << "Cannot write the cache " << CacheFile << "\n";
     }
+  }
+
+  /**
+   * Writes the facts of the run to the snapshot file.
+   */
+  static void saveSnapshot(SnapshotWriter &snapshot)
+  {
+    if (!snapshot.save())
+    {
+      llvm::errs() << "Cannot write the snapshot " << SnapshotFile << "\n";
+    }
+  }
+
+  bool OOBCheckerPass::doFinalization(llvm::Module &module)
+  {
+    if (resultCache)
+    {
+      saveCache(*resultCache);
+      cache = nullptr;
+      resultCache.reset();
+    }
+    if (snapshotWriter)
+    {
+      saveSnapshot(*snapshotWriter);
+      snapshot = nullptr;
+      snapshotWriter.reset();
+    }
+    triaged.print(llvm::errs());
+    printPhaseTimes(llvm::errs());
+    diagnostics = nullptr;
+    diagnosticStream.reset();
+    contexts = nullptr;
+    moduleContexts.reset();
+    summaries = nullptr;
+    moduleSummaries.reset();
+    moduleSizes.reset();
+    modulePA.reset();
     return false;
   }
 
@@ -50,38 +85,179 @@ namespace dataflow
   {
     llvm::outs() << "Running " << getAnalysisName() << " on " << func.getName() << "\n";
 
-    // Initializing InMap and OutMap.
-    AnalysisContext context{PointerAnalysis{func}};
-    for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter)
+    analyzeAndReport(func, *modulePA, *moduleSizes);
+    return false;
+  }
+
+  llvm::PreservedAnalyses OOBCheckerNewPass::run(llvm::Module &module,
+                                                 llvm::ModuleAnalysisManager &manager)
+  {
+    // Computed once here so every IntervalRangeAnalysis below can reuse it.
+    auto &shared = *manager.getResult<OOBModuleAnalysis>(module).facts;
+    auto &functions = manager.getResult<llvm::FunctionAnalysisManagerModuleProxy>(module).getManager();
+    // The cache keys hash the summaries the analysis used.
+    summaries = shared.summaries.get();
+    contexts = shared.contexts.get();
+    std::unique_ptr<ResultCache> resultCache;
+    if (!CacheFile.empty())
     {
-      auto ins = &(*iter);
-      context.in[ins] = {};
-      context.out[ins] = {};
+      resultCache = std::make_unique<ResultCache>(CacheFile);
+      cache = resultCache.get();
     }
-
-    // The chaotic iteration algorithm is implemented inside doAnalysis().
-    auto pa = PointerAnalysis(func);
-    doAnalysis(func, context);
-
-    // Check each instruction in function F for potential divide-by-zero error.
-    for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter)
+    auto diagnosticStream = DiagnosticStream::open();
+    diagnostics = diagnosticStream.get();
+    auto snapshotWriter = SnapshotWriter::open();
+    if (snapshotWriter)
+    {
+      snapshotWriter->addModule(module, *shared.pa, *shared.sizes);
+    }
+    snapshot = snapshotWriter.get();
+    for (auto &func : module)
     {
-      auto ins = &(*iter);
-      if (check(ins, context))
+      if (func.isDeclaration())
+      {
+        continue;
+      }
+      llvm::outs() << "Running " << getAnalysisName() << " on " << func.getName() << "\n";
+      NameScope names(func);
+      if (!reportWithoutDataflow(func, *shared.sizes))
       {
-        llvm::errs() << "Potential array out of bounds error: " << *ins << "\n";
+        reportCached(func, *shared.pa, *shared.sizes, [&]() -> const AnalysisContext &
+                     { return functions.getResult<IntervalRangeAnalysis>(func).context(); });
       }
     }
+    diagnostics = nullptr;
+    snapshot = nullptr;
+    cache = nullptr;
+    contexts = nullptr;
+    summaries = nullptr;
+    if (resultCache)
+    {
+      saveCache(*resultCache);
+    }
+    if (snapshotWriter)
+    {
+      saveSnapshot(*snapshotWriter);
+    }
+    triaged.print(llvm::errs());
+    printPhaseTimes(llvm::errs());
+    return llvm::PreservedAnalyses::all();
+  }
 
-    for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter)
+  /**
+   * Runs the thread or process driver, whichever the options ask for.
+   */
+  static void runParallel(const llvm::Module &module, const PointerAnalysis &pa,
+                          const ObjectSizeAnalysis &sizes, const SummaryTable *summaries,
+                          const char *name)
+  {
+    auto contexts = ContextCache::build(pa, sizes, summaries);
+    std::unique_ptr<ResultCache> resultCache;
+    if (!CacheFile.empty())
+    {
+      resultCache = std::make_unique<ResultCache>(CacheFile);
+    }
+    auto diagnostics = DiagnosticStream::open();
+    auto snapshot = SnapshotWriter::open();
+    if (snapshot)
+    {
+      snapshot->addModule(module, pa, sizes);
+    }
+    if (Shards)
     {
-      auto ins = &*iter;
-      printInstructionTransfer(ins, context.in.at(ins), context.out.at(ins));
+      ShardedDriver driver(pa, sizes, Shards, ShardTimeout);
+      driver.cache = resultCache.get();
+      driver.summaries = summaries;
+      driver.contexts = contexts.get();
+      driver.diagnostics = diagnostics.get();
+      driver.snapshot = snapshot.get();
+      driver.run(module, name);
+      driver.triaged.print(llvm::errs());
     }
+    else
+    {
+      ParallelDriver driver(pa, sizes, Jobs);
+      driver.cache = resultCache.get();
+      driver.summaries = summaries;
+      driver.contexts = contexts.get();
+      driver.diagnostics = diagnostics.get();
+      driver.snapshot = snapshot.get();
+      driver.run(module, name);
+      driver.triaged.print(llvm::errs());
+    }
+    if (resultCache)
+    {
+      saveCache(*resultCache);
+    }
+    if (snapshot)
+    {
+      saveSnapshot(*snapshot);
+    }
+    printPhaseTimes(llvm::errs());
+  }
+
+  bool OOBCheckerParallelPass::runOnModule(llvm::Module &module)
+  {
+    PointerAnalysis pa(module, DemandDrivenPA);
+    ObjectSizeAnalysis sizes(module, pa);
+    auto summaries = SummaryTable::build(module, pa, sizes);
+    runParallel(module, pa, sizes, summaries.get(), "OOBCheckerPass");
     return false;
   }
 
+  llvm::PreservedAnalyses OOBCheckerParallelNewPass::run(llvm::Module &module,
+                                                         llvm::ModuleAnalysisManager &manager)
+  {
+    auto &shared = *manager.getResult<OOBModuleAnalysis>(module).facts;
+    runParallel(module, *shared.pa, *shared.sizes, shared.summaries.get(), "OOBCheckerPass");
+    return llvm::PreservedAnalyses::all();
+  }
+
   char OOBCheckerPass::ID = 1;
   static llvm::RegisterPass<OOBCheckerPass> X("OOBChecker", "Array Out of Bounds Checker",
                                               false, false);
+
+  char OOBCheckerParallelPass::ID = 2;
+  static llvm::RegisterPass<OOBCheckerParallelPass> Y("OOBCheckerParallel",
+                                                      "Array Out of Bounds Checker (parallel)",
+                                                      false, false);
 } // namespace dataflow
+
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo llvmGetPassPluginInfo()
+{
+  using namespace dataflow;
+  return {LLVM_PLUGIN_API_VERSION, "OOBChecker", LLVM_VERSION_STRING, [](llvm::PassBuilder &builder)
+          {
+            builder.registerAnalysisRegistrationCallback([](llvm::ModuleAnalysisManager &manager)
+                                                         {
+                                                           manager.registerPass([] { return OOBModuleAnalysis(); });
+                                                           manager.registerPass([] { return OOBModuleRegistry(); });
+                                                         });
+            builder.registerAnalysisRegistrationCallback([](llvm::FunctionAnalysisManager &manager)
+                                                         { manager.registerPass([] { return IntervalRangeAnalysis(); }); });
+            builder.registerPipelineParsingCallback(
+                [](llvm::StringRef name, llvm::ModulePassManager &passes,
+                   llvm::ArrayRef<llvm::PassBuilder::PipelineElement>)
+                {
+                  if (name == "oob-checker")
+                  {
+                    passes.addPass(OOBCheckerNewPass());
+                    return true;
+                  }
+                  if (name == "oob-checker-parallel")
+                  {
+                    passes.addPass(OOBCheckerParallelNewPass());
+                    return true;
+                  }
+                  return false;
+                });
+            // -fpass-plugin: check the IR as the front end emitted it.
+#if LLVM_VERSION_MAJOR >= 12
+            builder.registerPipelineStartEPCallback([](llvm::ModulePassManager &passes, auto)
+                                                    { passes.addPass(OOBCheckerNewPass()); });
+#else
+            builder.registerPipelineStartEPCallback([](llvm::ModulePassManager &passes)
+                                                    { passes.addPass(OOBCheckerNewPass()); });
+#endif
+          }};
+}
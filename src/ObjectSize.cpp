@@ -0,0 +1,331 @@
+#include "ObjectSize.h"
+#include "Timing.h"
+#include "Utils.h"
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/InstIterator.h>
+#include <algorithm>
+
+namespace dataflow {
+
+// Sizes still changing after this many rounds (e.g. a pointer incremented
+// in a loop) are dropped to unknown instead of being walked one by one.
+static const int MAX_ROUNDS = 16;
+
+/**
+ * @brief Returns the function a value is local to, if any.
+ */
+static const llvm::Function *parentOf(const llvm::Value *val) {
+  if (auto ins = llvm::dyn_cast<llvm::Instruction>(val)) {
+    return ins->getFunction();
+  }
+  if (auto arg = llvm::dyn_cast<llvm::Argument>(val)) {
+    return arg->getParent();
+  }
+  return nullptr;
+}
+
+ObjectSize ObjectSize::unknown() {
+  return ObjectSize{IntervalDomain(0, Interval::INT_INF)};
+}
+
+ObjectSize ObjectSize::shifted(int by) const {
+  ObjectSize ret = *this;
+  if (isSymbolic()) {
+    ret.offset += by;
+  } else if (*this != unknown()) {
+    ret.elements = elements - IntervalDomain(by);
+    ret.elements.clamp(0, Interval::INT_INF);
+    if (ret.elements.isEmpty()) {
+      ret.elements = IntervalDomain(0);
+    }
+  }
+  return ret;
+}
+
+bool ObjectSize::join(const ObjectSize &other) {
+  if (*this == other) {
+    return false;
+  }
+  if (!isSymbolic() && !other.isSymbolic()) {
+    auto joined = elements | other.elements;
+    if (joined == elements) {
+      return false;
+    }
+    elements = joined;
+    return true;
+  }
+  if (isSymbolic() && other.isSymbolic() && symbol == other.symbol &&
+      scale == other.scale && divisor == other.divisor) {
+    // Advanced further along some path: keep the smaller size.
+    if (other.offset <= offset) {
+      return false;
+    }
+    offset = other.offset;
+    return true;
+  }
+  // No single expression covers both sizes.
+  if (*this == unknown()) {
+    return false;
+  }
+  *this = unknown();
+  return true;
+}
+
+IntervalDomain ObjectSize::evaluate(const FactMap &facts) const {
+  if (!isSymbolic()) {
+    return elements;
+  }
+  auto count = facts.getOrExtract(symbol);
+  if (count.isUnknown()) {
+    return unknown().elements;
+  }
+  auto ret = count * IntervalDomain(scale) / IntervalDomain(divisor) - IntervalDomain(offset);
+  ret.clamp(0, Interval::INT_INF);
+  return ret.isEmpty() ? IntervalDomain(0) : ret;
+}
+
+ObjectSizeAnalysis::ObjectSizeAnalysis(llvm::Module &module, const PointerAnalysis &pa)
+    : _pa(pa) {
+  PhaseTimer timer(Phase::ObjectSizes);
+  solve([this, &module] {
+    bool changed = false;
+    for (auto &func : module) {
+      for (auto &arg : func.args()) {
+        changed |= visit(&arg);
+      }
+      for (auto iter = llvm::inst_begin(func), end = llvm::inst_end(func); iter != end; ++iter) {
+        changed |= visit(&*iter);
+      }
+    }
+    return changed;
+  });
+}
+
+ObjectSizeAnalysis::ObjectSizeAnalysis(const llvm::Function &func, const PointerAnalysis &pa)
+    : _pa(pa) {
+  PhaseTimer timer(Phase::ObjectSizes);
+  solve([this, &func] {
+    bool changed = false;
+    for (auto iter = llvm::inst_begin(func), end = llvm::inst_end(func); iter != end; ++iter) {
+      changed |= visit(&*iter);
+    }
+    return changed;
+  });
+}
+
+ObjectSizeAnalysis::ObjectSizeAnalysis(const ObjectSizeAnalysis &base, const llvm::Function &func,
+                                       const std::map<unsigned, IntervalDomain> &argSizes)
+    : _pa(base._pa), _base(&base), _func(&func) {
+  for (auto &arg : func.args()) {
+    auto iter = argSizes.find(arg.getArgNo());
+    if (iter != argSizes.end()) {
+      _sizes[&arg] = ObjectSize{iter->second};
+    } else if (auto size = base.find(&arg)) {
+      _sizes[&arg] = *size;
+    }
+  }
+  solve([this, &func] {
+    bool changed = false;
+    for (auto iter = llvm::inst_begin(func), end = llvm::inst_end(func); iter != end; ++iter) {
+      changed |= visit(&*iter);
+    }
+    return changed;
+  });
+}
+
+void ObjectSizeAnalysis::solve(const std::function<bool()> &visitAll) {
+  // First settle everything that has a known size, then treat whatever is
+  // still missing as unknown and let that propagate too.
+  for (bool final : {false, true}) {
+    _final = final;
+    bool changed = true;
+    for (int round = 0; changed; ++round) {
+      auto before = _sizes;
+      changed = visitAll();
+      if (changed && round >= MAX_ROUNDS) {
+        for (auto &entry : _sizes) {
+          auto old = before.find(entry.first);
+          if (old == before.end() || old->second != entry.second) {
+            entry.second = ObjectSize::unknown();
+          }
+        }
+      }
+    }
+  }
+}
+
+IntervalDomain ObjectSizeAnalysis::lookup(const llvm::Value *ptr, const FactMap &facts) const {
+  auto size = find(ptr);
+  if (!size) {
+    return ObjectSize::unknown().elements;
+  }
+  return size->evaluate(facts);
+}
+
+bool ObjectSizeAnalysis::update(SizeMap &map, const llvm::Value *val, ObjectSize size) {
+  // The facts a symbol is evaluated against only exist in its own function.
+  if (size.isSymbolic() && &map == &_sizes && parentOf(val) != parentOf(size.symbol)) {
+    size = ObjectSize::unknown();
+  }
+  auto iter = map.find(val);
+  if (iter == map.end()) {
+    map[val] = size;
+    return true;
+  }
+  return iter->second.join(size);
+}
+
+bool ObjectSizeAnalysis::read(const SizeMap &map, const llvm::Value *val, ObjectSize &size) const {
+  auto iter = map.find(val);
+  bool found = iter != map.end();
+  if (found) {
+    size = iter->second;
+  }
+  // Values of other functions, and memory they may write too.
+  if (_base && parentOf(val) != _func) {
+    auto &baseMap = &map == &_sizes ? _base->_sizes : _base->_contents;
+    auto baseIter = baseMap.find(val);
+    if (baseIter != baseMap.end()) {
+      if (found) {
+        size.join(baseIter->second);
+      } else {
+        size = baseIter->second;
+      }
+      found = true;
+    }
+  }
+  if (found) {
+    return true;
+  }
+  size = ObjectSize::unknown();
+  return _final;
+}
+
+bool ObjectSizeAnalysis::allocationSize(const llvm::Instruction *ins, ObjectSize &size) const {
+  const int elementSize = sizeof(int);
+  if (auto alloca = llvm::dyn_cast<llvm::AllocaInst>(ins)) {
+    if (auto arrayType = llvm::dyn_cast<llvm::ArrayType>(alloca->getAllocatedType())) {
+      size = ObjectSize{IntervalDomain((int)arrayType->getNumElements())};
+      return true;
+    }
+    // Variable length array: alloca T, n
+    auto count = alloca->getArraySize();
+    if (!llvm::isa<llvm::ConstantInt>(count)) {
+      size = ObjectSize{IntervalDomain(0), count};
+      return true;
+    }
+    if (alloca->isArrayAllocation()) {
+      size = ObjectSize{IntervalDomain((int)llvm::cast<llvm::ConstantInt>(count)->getSExtValue())};
+      return true;
+    }
+    return false;
+  }
+  if (!isAllocationCall(ins)) {
+    return false;
+  }
+  auto call = llvm::cast<llvm::CallInst>(ins);
+  if (call->getCalledFunction()->getName() == "malloc") {
+    // malloc(bytes)
+    auto bytes = call->getArgOperand(0);
+    if (auto ci = llvm::dyn_cast<llvm::ConstantInt>(bytes)) {
+      size = ObjectSize{IntervalDomain((int)(ci->getZExtValue() / elementSize))};
+    } else {
+      size = ObjectSize{IntervalDomain(0), bytes, 1, elementSize};
+    }
+    return true;
+  }
+  // calloc(count, bytes)
+  auto count = llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(0));
+  auto bytes = llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(1));
+  if (count && bytes) {
+    size = ObjectSize{IntervalDomain((int)(count->getZExtValue() * bytes->getZExtValue() / elementSize))};
+  } else if (bytes) {
+    size = ObjectSize{IntervalDomain(0), call->getArgOperand(0), (int)bytes->getZExtValue(), elementSize};
+  } else if (count) {
+    size = ObjectSize{IntervalDomain(0), call->getArgOperand(1), (int)count->getZExtValue(), elementSize};
+  } else {
+    size = ObjectSize::unknown();
+  }
+  return true;
+}
+
+std::vector<const llvm::Value *> ObjectSizeAnalysis::objects(const llvm::Value *ptr) const {
+  auto ret = _pa.pointees(ptr);
+  // Without points-to facts, the pointer itself stands for its memory.
+  if (ret.empty()) {
+    ret.push_back(ptr);
+  }
+  return ret;
+}
+
+bool ObjectSizeAnalysis::visit(const llvm::Argument *arg) {
+  auto func = arg->getParent();
+  // Only direct calls are visible, so give up on escaping functions.
+  if (!arg->getType()->isPointerTy() || func->hasAddressTaken() || func->use_empty()) {
+    return false;
+  }
+  bool changed = false;
+  for (auto user : func->users()) {
+    auto call = llvm::dyn_cast<llvm::CallInst>(user);
+    if (!call || arg->getArgNo() >= call->arg_size()) {
+      continue;
+    }
+    ObjectSize size;
+    if (read(_sizes, call->getArgOperand(arg->getArgNo()), size)) {
+      changed |= update(_sizes, arg, size);
+    }
+  }
+  return changed;
+}
+
+bool ObjectSizeAnalysis::visit(const llvm::Instruction *ins) {
+  ObjectSize size;
+  if (allocationSize(ins, size)) {
+    return update(_sizes, ins, size);
+  } else if (auto cast = llvm::dyn_cast<llvm::CastInst>(ins)) {
+    if (cast->getType()->isPointerTy() && read(_sizes, cast->getOperand(0), size)) {
+      return update(_sizes, cast, size);
+    }
+  } else if (auto gep = llvm::dyn_cast<llvm::GetElementPtrInst>(ins)) {
+    if (read(_sizes, gep->getPointerOperand(), size)) {
+      if (auto ci = llvm::dyn_cast<llvm::ConstantInt>(gep->getOperand(1))) {
+        size = size.shifted(ci->getSExtValue());
+      }
+      return update(_sizes, gep, size);
+    }
+  } else if (auto phi = llvm::dyn_cast<llvm::PHINode>(ins)) {
+    bool changed = false;
+    if (phi->getType()->isPointerTy()) {
+      for (auto &incoming : phi->incoming_values()) {
+        if (read(_sizes, incoming, size)) {
+          changed |= update(_sizes, phi, size);
+        }
+      }
+    }
+    return changed;
+  } else if (auto store = llvm::dyn_cast<llvm::StoreInst>(ins)) {
+    // *pointer_op = value_op
+    bool changed = false;
+    if (store->getValueOperand()->getType()->isPointerTy() &&
+        read(_sizes, store->getValueOperand(), size)) {
+      for (auto object : objects(store->getPointerOperand())) {
+        changed |= update(_contents, object, size);
+      }
+    }
+    return changed;
+  } else if (auto load = llvm::dyn_cast<llvm::LoadInst>(ins)) {
+    bool changed = false;
+    if (load->getType()->isPointerTy()) {
+      for (auto object : objects(load->getPointerOperand())) {
+        if (read(_contents, object, size)) {
+          changed |= update(_sizes, load, size);
+        }
+      }
+    }
+    return changed;
+  }
+  return false;
+}
+
+} // namespace dataflow
@@ -0,0 +1,67 @@
+#include "ParallelDriver.h"
+
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/ThreadPool.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace dataflow {
+
+llvm::cl::opt<unsigned> Jobs(
+    "oob-jobs",
+    llvm::cl::desc("Number of threads analyzing functions in parallel (0 = one per hardware thread)"),
+    llvm::cl::init(0));
+
+ParallelDriver::ParallelDriver(const PointerAnalysis &pa, const ObjectSizeAnalysis &sizes,
+                               unsigned jobs)
+    : _pa(pa), _sizes(sizes), _jobs(jobs) {}
+
+void ParallelDriver::run(const llvm::Module &module, llvm::StringRef name,
+                         llvm::raw_ostream &out, llvm::raw_ostream &err) {
+  struct Report {
+    const llvm::Function *func;
+    std::string out, err;
+  };
+  std::vector<Report> reports;
+  for (auto &func : module) {
+    if (!func.isDeclaration()) {
+      reports.push_back({&func, "", ""});
+    }
+  }
+
+  // Largest functions first, so a big one started last does not keep a
+  // single thread busy after all the others are done.
+  std::vector<Report *> order;
+  for (auto &task : reports) {
+    order.push_back(&task);
+  }
+  std::stable_sort(order.begin(), order.end(), [](const Report *lhs, const Report *rhs) {
+    return lhs->func->getInstructionCount() > rhs->func->getInstructionCount();
+  });
+
+  {
+#if LLVM_VERSION_MAJOR >= 11
+    llvm::ThreadPool pool(llvm::hardware_concurrency(_jobs));
+#else
+    llvm::ThreadPool pool(_jobs ? _jobs : llvm::hardware_concurrency());
+#endif
+    for (auto task : order) {
+      pool.async([this, task] {
+        llvm::raw_string_ostream outStream(task->out), errStream(task->err);
+        analyzeAndReport(*task->func, _pa, _sizes, outStream, errStream);
+        outStream.flush();
+        errStream.flush();
+      });
+    }
+    pool.wait();
+  }
+
+  // Merge in source order.
+  for (auto &task : reports) {
+    out << "Running " << name << " on " << task.func->getName() << "\n" << task.out;
+    err << task.err;
+  }
+}
+
+} // namespace dataflow
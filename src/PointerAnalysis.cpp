@@ -1,73 +1,196 @@
 #include "PointerAnalysis.h"
+#include "Timing.h"
 #include "Utils.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 
+#include <algorithm>
+
+#define DEBUG_TYPE "pointer-analysis"
+
+STATISTIC(NumRounds, "Number of rounds of the points-to solver");
+STATISTIC(NumAliasQueries, "Number of alias and points-to queries");
+
 namespace dataflow {
 using namespace llvm;
-void PointerAnalysis::transfer(Instruction *Inst, PointsToInfo &PointsTo) {
+std::string PointerAnalysis::key(const Value *Val) const {
+  // variable() prints the type first for arguments, which would make every
+  // pointer argument of a function share one key.
+  std::string Key = variable(Val);
+  if (auto *Arg = dyn_cast<Argument>(Val))
+    Key = "%" + (Arg->hasName() ? Arg->getName().str()
+                                : std::to_string(Arg->getArgNo()));
+  if (!Qualified)
+    return Key;
+  if (auto *Inst = dyn_cast<Instruction>(Val))
+    return Inst->getFunction()->getName().str() + "::" + Key;
+  if (auto *Arg = dyn_cast<Argument>(Val))
+    return Arg->getParent()->getName().str() + "::" + Key;
+  return Key;
+}
+
+std::string PointerAnalysis::object(const Value *Val) const {
+  std::string Object = address(Val);
+  if (!Qualified)
+    return Object;
+  if (auto *Inst = dyn_cast<Instruction>(Val))
+    return Inst->getFunction()->getName().str() + "::" + Object;
+  return Object;
+}
+
+std::string PointerAnalysis::returnKey(const Function &Func) const {
+  return Func.getName().str() + "::<return>";
+}
+
+void PointerAnalysis::transfer(Instruction *Inst, ConstraintList &Constraints) {
   if (AllocaInst *Alloca = dyn_cast<AllocaInst>(Inst)) {
-    std::string Pointer = variable(Alloca);
-    PointsToSet &S = PointsTo[variable(Alloca)];
-    S.insert(address(Alloca));
+    Objects[object(Alloca)] = Alloca;
+    ObjectNames[object(Alloca)] = key(Alloca);
+    Constraints.push_back({Constraint::Addr, key(Alloca), object(Alloca)});
+  } else if (isAllocationCall(Inst)) {
+    Objects[object(Inst)] = Inst;
+    ObjectNames[object(Inst)] = key(Inst);
+    Constraints.push_back({Constraint::Addr, key(Inst), object(Inst)});
   } else if (StoreInst *Store = dyn_cast<StoreInst>(Inst)) {
     if (!Store->getValueOperand()->getType()->isPointerTy())
       return;
     Value *Pointer = Store->getPointerOperand();
     Value *Value = Store->getValueOperand();
-    PointsToSet &L = PointsTo[variable(Pointer)];
-    PointsToSet &R = PointsTo[variable(Value)];
-    for (auto &I : L) {
-      PointsToSet &S = PointsTo[I];
-      PointsToSet Result;
-      std::set_union(S.begin(), S.end(), R.begin(), R.end(),
-                     std::inserter(Result, Result.begin()));
-      PointsTo[I] = Result;
-    }
+    Constraints.push_back({Constraint::Store, key(Pointer), key(Value)});
   } else if (LoadInst *Load = dyn_cast<LoadInst>(Inst)) {
     if (!Load->getType()->isPointerTy())
       return;
-    std::string Variable = variable(Load->getPointerOperand());
-    PointsToSet &R = PointsTo[Variable];
-    PointsToSet &L = PointsTo[variable(Load)];
-    PointsToSet Result;
-    for (auto &I : R) {
-      PointsToSet &S = PointsTo[I];
-      std::set_union(S.begin(), S.end(), Result.begin(), Result.end(),
-                     std::inserter(Result, Result.begin()));
+    Constraints.push_back(
+        {Constraint::Load, key(Load), key(Load->getPointerOperand())});
+  } else if (isa<CastInst>(Inst) || isa<GetElementPtrInst>(Inst)) {
+    if (!Inst->getType()->isPointerTy() ||
+        !Inst->getOperand(0)->getType()->isPointerTy())
+      return;
+    Constraints.push_back({Constraint::Copy, key(Inst), key(Inst->getOperand(0))});
+  } else if (!Qualified) {
+    // Calls and returns only connect functions solved together.
+    return;
+  } else if (CallInst *Call = dyn_cast<CallInst>(Inst)) {
+    Function *Callee = Call->getCalledFunction();
+    if (!Callee || Callee->isDeclaration())
+      return;
+    unsigned NumArgs = std::min<unsigned>(Call->arg_size(), Callee->arg_size());
+    for (unsigned I = 0; I < NumArgs; ++I) {
+      Value *Actual = Call->getArgOperand(I);
+      if (Actual->getType()->isPointerTy())
+        Constraints.push_back(
+            {Constraint::Copy, key(Callee->arg_begin() + I), key(Actual)});
     }
-    PointsTo[variable(Load)] = Result;
+    if (Call->getType()->isPointerTy())
+      Constraints.push_back({Constraint::Copy, key(Call), returnKey(*Callee)});
+  } else if (ReturnInst *Ret = dyn_cast<ReturnInst>(Inst)) {
+    Value *RetVal = Ret->getReturnValue();
+    if (RetVal && RetVal->getType()->isPointerTy())
+      Constraints.push_back(
+          {Constraint::Copy, returnKey(*Ret->getFunction()), key(RetVal)});
   }
 }
 
-int PointerAnalysis::countFacts(PointsToInfo &PointsTo) {
-  int N = 0;
-  for (auto &I : PointsTo)
-    N += I.second.size();
-  return N;
+const std::string &PointerAnalysis::find(const std::string &Var) const {
+  auto It = Rep.find(Var);
+  return It == Rep.end() ? Var : It->second;
 }
 
-void PointerAnalysis::print(std::map<std::string, PointsToSet> &PointsTo) {
-  errs() << "Pointer Analysis Results:\n";
-  for (auto &I : PointsTo) {
-    errs() << "  " << I.first << ": { ";
-    for (auto &J : I.second) {
-      errs() << J << "; ";
+void PointerAnalysis::reduce(ConstraintList &Constraints) {
+  std::map<std::string, unsigned> NumDefs;
+  for (auto &C : Constraints)
+    if (C.Kind != Constraint::Store)
+      ++NumDefs[C.Dst];
+
+  std::map<std::string, unsigned> VN;
+  std::map<unsigned, std::string> LoadOf;
+  unsigned NextVN = 0;
+  auto number = [&](const std::string &Var) {
+    auto It = VN.find(Var);
+    if (It != VN.end())
+      return It->second;
+    return VN[Var] = NextVN++;
+  };
+
+  for (auto &C : Constraints) {
+    if (C.Kind != Constraint::Load && C.Kind != Constraint::Copy)
+      continue;
+    // A variable used before its definition keeps the fresh number it got
+    // at the use, which only costs us a missed merge.
+    if (NumDefs[C.Dst] != 1 || VN.count(C.Dst)) {
+      number(C.Dst);
+      continue;
     }
-    errs() << "}\n";
+    if (C.Kind == Constraint::Copy) {
+      // A variable that is only ever a copy of Src is Src.
+      VN[C.Dst] = number(C.Src);
+      Rep[C.Dst] = find(C.Src);
+      continue;
+    }
+    unsigned SrcVN = number(C.Src);
+    auto It = LoadOf.find(SrcVN);
+    if (It == LoadOf.end()) {
+      LoadOf[SrcVN] = C.Dst;
+      number(C.Dst);
+    } else {
+      Rep[C.Dst] = It->second;
+      VN[C.Dst] = VN[It->second];
+    }
+  }
+
+  for (auto &C : Constraints) {
+    C.Dst = find(C.Dst);
+    if (C.Kind != Constraint::Addr)
+      C.Src = find(C.Src);
   }
-  errs() << "\n";
+  Constraints.erase(std::remove_if(Constraints.begin(), Constraints.end(),
+                                   [](const Constraint &C) {
+                                     return C.Kind == Constraint::Copy &&
+                                            C.Dst == C.Src;
+                                   }),
+                    Constraints.end());
+  std::sort(Constraints.begin(), Constraints.end());
+  Constraints.erase(std::unique(Constraints.begin(), Constraints.end()),
+                    Constraints.end());
 }
 
-PointerAnalysis::PointerAnalysis(Function &F) {
+void PointerAnalysis::solve(const ConstraintList &Constraints) {
   int NumOfOldFacts = 0;
   int NumOfNewFacts = 0;
 
   while (true) {
-    for (inst_iterator Iter = inst_begin(F), E = inst_end(F); Iter != E; ++Iter) {
-      auto Inst = &*Iter;
-      transfer(Inst, PointsTo);
+    ++NumRounds;
+    for (auto &C : Constraints) {
+      switch (C.Kind) {
+      case Constraint::Addr:
+        PointsTo[C.Dst].insert(C.Src);
+        break;
+      case Constraint::Copy: {
+        const PointsToSet &R = PointsTo[C.Src];
+        PointsTo[C.Dst].insert(R.begin(), R.end());
+        break;
+      }
+      case Constraint::Store: {
+        const PointsToSet &L = PointsTo[C.Dst];
+        const PointsToSet &R = PointsTo[C.Src];
+        for (auto &I : L)
+          PointsTo[I].insert(R.begin(), R.end());
+        break;
+      }
+      case Constraint::Load: {
+        const PointsToSet &R = PointsTo[C.Src];
+        PointsToSet &Result = PointsTo[C.Dst];
+        for (auto &I : R) {
+          const PointsToSet &S = PointsTo[I];
+          Result.insert(S.begin(), S.end());
+        }
+        break;
+      }
+      }
     }
     NumOfNewFacts = countFacts(PointsTo);
     if (NumOfOldFacts < NumOfNewFacts)
@@ -75,15 +198,172 @@ PointerAnalysis::PointerAnalysis(Function &F) {
     else
       break;
   }
-  print(PointsTo);
 }
 
-bool PointerAnalysis::alias(std::string &Ptr1, std::string &Ptr2) const {
-  if (PointsTo.find(Ptr1) == PointsTo.end() ||
-      PointsTo.find(Ptr2) == PointsTo.end())
+int PointerAnalysis::countFacts(PointsToInfo &PointsTo) {
+  int N = 0;
+  for (auto &I : PointsTo)
+    N += I.second.size();
+  return N;
+}
+
+void PointerAnalysis::print(std::map<std::string, PointsToSet> &PointsTo,
+                            raw_ostream &OS) {
+  // Show merged variables alongside their representative.
+  std::map<std::string, PointsToSet> Expanded = PointsTo;
+  for (auto &I : Rep)
+    Expanded[I.first] = PointsTo[I.second];
+
+  OS << "Pointer Analysis Results:\n";
+  for (auto &I : Expanded) {
+    OS << "  " << I.first << ": { ";
+    for (auto &J : I.second) {
+      OS << J << "; ";
+    }
+    OS << "}\n";
+  }
+  OS << "\n";
+}
+
+void PointerAnalysis::collectDemand(const std::vector<Function *> &Funcs,
+                                    std::vector<Instruction *> &Slice) {
+  SmallPtrSet<const Function *, 8> InScope(Funcs.begin(), Funcs.end());
+  SmallPtrSet<Value *, 32> Visited;
+  SmallVector<Value *, 32> Worklist;
+  for (Function *F : Funcs)
+    for (inst_iterator Iter = inst_begin(F), E = inst_end(F); Iter != E; ++Iter)
+      if (auto *GEP = dyn_cast<GetElementPtrInst>(&*Iter))
+        for (Value *Op : GEP->operands())
+          Worklist.push_back(Op);
+
+  auto calleeInScope = [&](CallInst *Call) -> Function * {
+    Function *Callee = Call->getCalledFunction();
+    if (!Qualified || !Callee || !InScope.count(Callee))
+      return nullptr;
+    return Callee;
+  };
+
+  while (!Worklist.empty()) {
+    Value *V = Worklist.pop_back_val();
+    if (!Visited.insert(V).second)
+      continue;
+    // Backwards: whatever the value is computed from.
+    if (auto *Load = dyn_cast<LoadInst>(V)) {
+      Worklist.push_back(Load->getPointerOperand());
+    } else if (isa<CastInst>(V) || isa<BinaryOperator>(V) || isa<CmpInst>(V) ||
+               isa<PHINode>(V) || isa<SelectInst>(V) ||
+               isa<GetElementPtrInst>(V)) {
+      for (Value *Op : cast<Instruction>(V)->operands())
+        Worklist.push_back(Op);
+    } else if (auto *Call = dyn_cast<CallInst>(V)) {
+      if (Function *Callee = calleeInScope(Call))
+        for (inst_iterator Iter = inst_begin(Callee), E = inst_end(Callee);
+             Iter != E; ++Iter)
+          if (auto *Ret = dyn_cast<ReturnInst>(&*Iter))
+            if (Ret->getReturnValue())
+              Worklist.push_back(Ret->getReturnValue());
+    } else if (auto *Arg = dyn_cast<Argument>(V)) {
+      if (Qualified)
+        for (User *U : Arg->getParent()->users())
+          if (auto *Call = dyn_cast<CallInst>(U))
+            if (calleeInScope(Call) == Arg->getParent() &&
+                Arg->getArgNo() < Call->arg_size())
+              Worklist.push_back(Call->getArgOperand(Arg->getArgNo()));
+    }
+    if (!V->getType()->isPointerTy())
+      continue;
+    // Through memory: the values stored into a relevant pointer, the
+    // locations it escapes to and the pointers derived from it.
+    for (User *U : V->users()) {
+      auto *UserInst = dyn_cast<Instruction>(U);
+      if (!UserInst || !InScope.count(UserInst->getFunction()))
+        continue;
+      if (auto *Store = dyn_cast<StoreInst>(U)) {
+        if (Store->getPointerOperand() == V)
+          Worklist.push_back(Store->getValueOperand());
+        else
+          Worklist.push_back(Store->getPointerOperand());
+      } else if (auto *Load = dyn_cast<LoadInst>(U)) {
+        if (Load->getType()->isPointerTy())
+          Worklist.push_back(Load);
+      } else if (isa<CastInst>(U) || isa<GetElementPtrInst>(U)) {
+        Worklist.push_back(U);
+      } else if (auto *Call = dyn_cast<CallInst>(U)) {
+        if (Function *Callee = calleeInScope(Call))
+          for (unsigned I = 0; I < Call->arg_size() && I < Callee->arg_size(); ++I)
+            if (Call->getArgOperand(I) == V)
+              Worklist.push_back(Callee->arg_begin() + I);
+      } else if (auto *Ret = dyn_cast<ReturnInst>(U)) {
+        if (Qualified)
+          for (User *CallUser : Ret->getFunction()->users())
+            if (auto *Call = dyn_cast<CallInst>(CallUser))
+              if (calleeInScope(Call) == Ret->getFunction())
+                Worklist.push_back(Call);
+      }
+    }
+  }
+
+  for (Function *F : Funcs)
+    for (inst_iterator Iter = inst_begin(F), E = inst_end(F); Iter != E; ++Iter) {
+      Instruction *Inst = &*Iter;
+      bool Relevant = Visited.count(Inst);
+      if (auto *Store = dyn_cast<StoreInst>(Inst))
+        Relevant = Visited.count(Store->getPointerOperand());
+      else if (auto *Ret = dyn_cast<ReturnInst>(Inst))
+        Relevant = Ret->getReturnValue() && Visited.count(Ret->getReturnValue());
+      else if (auto *Call = dyn_cast<CallInst>(Inst))
+        for (Value *Arg : Call->args())
+          Relevant |= Visited.count(Arg) != 0;
+      if (Relevant)
+        Slice.push_back(Inst);
+    }
+}
+
+void PointerAnalysis::build(const std::vector<Function *> &Funcs,
+                            bool DemandDriven, raw_ostream &Log) {
+  PhaseTimer Timer(Phase::PointsTo);
+  std::vector<Instruction *> Slice;
+  if (DemandDriven)
+    collectDemand(Funcs, Slice);
+  else
+    for (Function *F : Funcs)
+      for (inst_iterator Iter = inst_begin(F), E = inst_end(F); Iter != E; ++Iter)
+        Slice.push_back(&*Iter);
+
+  ConstraintList Constraints;
+  for (Instruction *Inst : Slice)
+    transfer(Inst, Constraints);
+  reduce(Constraints);
+  solve(Constraints);
+  if (Verbosity >= 1)
+    print(PointsTo, Log);
+}
+
+PointerAnalysis::PointerAnalysis(Function &F, bool DemandDriven,
+                                 raw_ostream &Log) {
+  build({&F}, DemandDriven, Log);
+}
+
+PointerAnalysis::PointerAnalysis(Module &M, bool DemandDriven, raw_ostream &Log)
+    : Qualified(true) {
+  std::vector<Function *> Funcs;
+  for (Function &F : M)
+    if (!F.isDeclaration())
+      Funcs.push_back(&F);
+  build(Funcs, DemandDriven, Log);
+}
+
+bool PointerAnalysis::alias(const Value *Ptr1, const Value *Ptr2) const {
+  ++NumAliasQueries;
+  const std::string Key1 = key(Ptr1);
+  const std::string Key2 = key(Ptr2);
+  const std::string &Rep1 = find(Key1);
+  const std::string &Rep2 = find(Key2);
+  if (PointsTo.find(Rep1) == PointsTo.end() ||
+      PointsTo.find(Rep2) == PointsTo.end())
     return false;
-  const PointsToSet &S1 = PointsTo.at(Ptr1);
-  const PointsToSet &S2 = PointsTo.at(Ptr2);
+  const PointsToSet &S1 = PointsTo.at(Rep1);
+  const PointsToSet &S2 = PointsTo.at(Rep2);
 
   PointsToSet Inter;
   std::set_intersection(S1.begin(), S1.end(), S2.begin(), S2.end(),
@@ -91,4 +371,32 @@ bool PointerAnalysis::alias(std::string &Ptr1, std::string &Ptr2) const {
   return !Inter.empty();
 }
 
+std::vector<const Value *> PointerAnalysis::pointees(const Value *Ptr) const {
+  ++NumAliasQueries;
+  std::vector<const Value *> Result;
+  auto It = PointsTo.find(find(key(Ptr)));
+  if (It == PointsTo.end())
+    return Result;
+  for (auto &Object : It->second) {
+    auto ObjIt = Objects.find(Object);
+    if (ObjIt != Objects.end())
+      Result.push_back(ObjIt->second);
+  }
+  return Result;
+}
+
+std::vector<std::string> PointerAnalysis::pointeeNames(const Value *Ptr) const {
+  std::vector<std::string> Result;
+  auto It = PointsTo.find(find(key(Ptr)));
+  if (It == PointsTo.end())
+    return Result;
+  for (auto &Object : It->second) {
+    auto NameIt = ObjectNames.find(Object);
+    if (NameIt != ObjectNames.end())
+      Result.push_back(NameIt->second);
+  }
+  std::sort(Result.begin(), Result.end());
+  return Result;
+}
+
 }; // namespace dataflow
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "RangeQuery.h"
+#include "ContextCache.h"
+#include "FunctionSummary.h"
+
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Instructions.h>
+
+namespace dataflow {
+
+RangeQuery::RangeQuery(const llvm::Function &func, AnalysisContext &context)
+    : _func(func), _context(context) {}
+
+bool RangeQuery::tryQuery(const llvm::Value *val, const llvm::Instruction *ins,
+                          IntervalDomain &ret) {
+  _failed = false;
+  _addedValues.clear();
+  _addedMemory.clear();
+  ret = val->getType()->isPointerTy() ? memory(val, ins) : value(val);
+  if (!_failed) {
+    return true;
+  }
+  // Whatever was memoized on the way may rest on the value that failed.
+  for (auto added : _addedValues) {
+    _values.erase(added);
+  }
+  for (auto &added : _addedMemory) {
+    _memory.erase(added);
+  }
+  _failed = false;
+  return false;
+}
+
+IntervalDomain RangeQuery::queryRange(const llvm::Value *val, const llvm::Instruction *ins) {
+  IntervalDomain ret;
+  if (tryQuery(val, ins, ret)) {
+    return ret;
+  }
+  analyzeAll();
+  return _context.in.at(ins).getOrExtract(val);
+}
+
+IntervalDomain RangeQuery::querySize(const llvm::Value *ptr, const llvm::Instruction *ins) {
+  FactMap facts;
+  auto size = _context.sizes.find(ptr);
+  if (size && size->isSymbolic()) {
+    facts[variable(size->symbol)] = queryRange(size->symbol, ins);
+  }
+  return _context.sizes.lookup(ptr, facts);
+}
+
+void RangeQuery::analyzeAll() {
+  if (_context.in.empty()) {
+    NameScope names(_func);
+    OOBChecker().analyze(_func, _context);
+  }
+}
+
+IntervalDomain RangeQuery::value(const llvm::Value *val) {
+  auto ins = llvm::dyn_cast<llvm::Instruction>(val);
+  if (!ins) {
+    // Arguments start out as in doAnalysis().
+    return llvm::isa<llvm::Argument>(val) ? _context.args.getOrExtract(val) : IntervalDomain{val};
+  }
+  if (_failed) {
+    return IntervalDomain::UNINIT();
+  }
+  auto memo = _values.find(ins);
+  if (memo != _values.end()) {
+    return memo->second;
+  }
+  if (_cyclic.count(ins) || !_active.insert(ins).second) {
+    _cyclic.insert(ins);
+    _failed = true;
+    return IntervalDomain::UNINIT();
+  }
+  auto ret = evaluate(ins);
+  _active.erase(ins);
+  if (!_failed) {
+    _values[ins] = ret;
+    _addedValues.push_back(ins);
+  }
+  return ret;
+}
+
+IntervalDomain RangeQuery::evaluate(const llvm::Instruction *ins) {
+  // The same cases as genSet(), with the facts of the operands asked for.
+  // The fact of a pointer is the one of the memory it points to.
+  auto fact = [this, ins](const llvm::Value *op) {
+    return op->getType()->isPointerTy() ? memory(op, ins) : value(op);
+  };
+  auto operands = [&fact, ins]() {
+    FactMap facts;
+    for (auto &op : ins->operands()) {
+      if (llvm::isa<llvm::Instruction>(op) || llvm::isa<llvm::Argument>(op)) {
+        facts[variable(op)] = fact(op);
+      }
+    }
+    return facts;
+  };
+  if (isInput(ins)) {
+    return IntervalDomain::INF_DOMAIN();
+  } else if (auto phi = llvm::dyn_cast<llvm::PHINode>(ins)) {
+    // eval() joins into an unknown domain, so only constant phis are known.
+    if (auto constant = phi->hasConstantValue()) {
+      return IntervalDomain{constant};
+    }
+    return IntervalDomain::UNINIT();
+  } else if (auto binOp = llvm::dyn_cast<llvm::BinaryOperator>(ins)) {
+    return eval(binOp, operands());
+  } else if (auto cast = llvm::dyn_cast<llvm::CastInst>(ins)) {
+    return fact(cast->getOperand(0));
+  } else if (auto cmp = llvm::dyn_cast<llvm::CmpInst>(ins)) {
+    return eval(cmp, operands());
+  } else if (auto load = llvm::dyn_cast<llvm::LoadInst>(ins)) {
+    if (load->getType()->isIntegerTy()) {
+      return memory(load->getPointerOperand(), load);
+    }
+  } else if (auto call = llvm::dyn_cast<llvm::CallInst>(ins)) {
+    auto summary = summaryOf(call);
+    if (summary && call->getType()->isIntegerTy()) {
+      return summary->ret;
+    }
+  }
+  return IntervalDomain{ins};
+}
+
+const FunctionSummary *RangeQuery::summaryOf(const llvm::CallInst *call) {
+  auto summary = _context.summaries ? _context.summaries->find(call) : nullptr;
+  if (!summary || !_context.contexts) {
+    return summary;
+  }
+  // The context of the call: its arguments, and the symbols of their sizes.
+  FactMap facts;
+  for (auto &arg : call->args()) {
+    const llvm::Value *val = arg;
+    if (val->getType()->isPointerTy()) {
+      auto size = _context.sizes.find(val);
+      val = size && size->isSymbolic() ? size->symbol : nullptr;
+    }
+    if (val && (llvm::isa<llvm::Instruction>(val) || llvm::isa<llvm::Argument>(val))) {
+      facts[variable(val)] = value(val);
+    }
+  }
+  if (_failed) {
+    return summary;
+  }
+  auto result = _context.contexts->lookup(call, facts);
+  if (!result) {
+    return summary;
+  }
+  return &result->summary;
+}
+
+IntervalDomain RangeQuery::memory(const llvm::Value *ptr, const llvm::Instruction *ins) {
+  if (_failed) {
+    return IntervalDomain::UNINIT();
+  }
+  auto key = std::make_pair(ptr, ins);
+  auto memo = _memory.find(key);
+  if (memo != _memory.end()) {
+    return memo->second;
+  }
+  IntervalDomain ret;
+  if (!reaching(ptr, ins, ret)) {
+    ret = IntervalDomain{ptr};
+  }
+  if (!_failed) {
+    _memory[key] = ret;
+    _addedMemory.push_back(key);
+  }
+  return ret;
+}
+
+bool RangeQuery::reaching(const llvm::Value *ptr, const llvm::Instruction *ins,
+                          IntervalDomain &ret) {
+  // Stores through an alias only reach pointers the fixpoint tracks.
+  bool tracked = llvm::isa<llvm::Instruction>(ptr) || llvm::isa<llvm::Argument>(ptr);
+  auto alloca = llvm::dyn_cast<llvm::AllocaInst>(ptr);
+  bool found = false;
+  // A path that does not write ptr adds nothing, like a missing key in
+  // FactMap::operator+=().
+  auto join = [&ret, &found](const IntervalDomain &val) {
+    if (found) {
+      ret |= val;
+    } else {
+      ret = val;
+      found = true;
+    }
+  };
+  std::unordered_set<const llvm::BasicBlock *> visited;
+  std::vector<std::pair<const llvm::BasicBlock *, const llvm::Instruction *>> worklist{
+      {ins->getParent(), ins}};
+  while (!worklist.empty() && !_failed) {
+    auto block = worklist.back().first;
+    auto from = worklist.back().second;
+    worklist.pop_back();
+
+    // Walk the block backwards from `from`, or from its end.
+    bool stopped = false;
+    auto iter = from ? from->getReverseIterator() : block->rbegin();
+    if (from) {
+      ++iter;
+    }
+    for (auto end = block->rend(); iter != end && !stopped; ++iter) {
+      auto current = &*iter;
+      if (auto store = llvm::dyn_cast<llvm::StoreInst>(current)) {
+        auto target = store->getPointerOperand();
+        auto stored = store->getValueOperand();
+        if (stored->getType()->isPointerTy()) {
+          continue;
+        }
+        if (target == ptr) {
+          join(value(stored));
+          stopped = true;
+        } else if (tracked && _context.pa.alias(target, ptr)) {
+          join(value(stored));
+        }
+      } else if (current == ptr) {
+        // Nothing reaches past the definition of ptr.
+        if (alloca && alloca->getAllocatedType()->isIntegerTy()) {
+          join(IntervalDomain::INF_DOMAIN());
+        }
+        stopped = true;
+      } else if (auto call = llvm::dyn_cast<llvm::CallInst>(current)) {
+        // A summarized callee may store through its arguments.
+        IntervalDomain written;
+        auto summary = summaryOf(call);
+        if (summary && summary->written(call, ptr, tracked, _context.pa, written)) {
+          join(written);
+        }
+      }
+    }
+    if (stopped) {
+      continue;
+    }
+    if (block == &_func.getEntryBlock()) {
+      if (llvm::isa<llvm::Argument>(ptr)) {
+        join(IntervalDomain{ptr});
+      }
+      continue;
+    }
+    for (auto pred = pred_begin(block), end = pred_end(block); pred != end; ++pred) {
+      if (visited.insert(*pred).second) {
+        worklist.push_back({*pred, nullptr});
+      }
+    }
+  }
+  return found;
+}
+
+} // namespace dataflow
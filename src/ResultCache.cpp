@@ -0,0 +1,451 @@
+#include "ResultCache.h"
+#include "ContextCache.h"
+#include "Diagnostics.h"
+#include "OOBChecker.h"
+#include "Utils.h"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <cstring>
+#include <fcntl.h>
+#include <set>
+#include <sstream>
+#include <sys/file.h>
+#include <unistd.h>
+#include <vector>
+
+namespace dataflow {
+
+llvm::cl::opt<std::string> CacheFile(
+    "oob-cache",
+    llvm::cl::desc("Reuse the reports of unchanged functions from this file, and add the new ones"),
+    llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<unsigned> CacheLimit(
+    "oob-cache-limit",
+    llvm::cl::desc("Drop the least recently used reports once the -oob-cache file grows past "
+                   "this many megabytes (0 for no limit)"),
+    llvm::cl::init(256));
+
+namespace {
+
+const char MAGIC[8] = {'O', 'O', 'B', 'C', 'A', 'C', 'H', 'E'};
+const uint32_t VERSION = 3;
+
+/// Hits only refresh the time an entry was last used if it is older than
+/// this, so runs that only hit do not rewrite the file every time.
+const uint32_t REFRESH_SECONDS = 24 * 60 * 60;
+
+// Layout of the file, in native byte order:
+//   FileHeader, IndexEntry[count] sorted by key, then the reports.
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t count;
+};
+
+struct IndexEntry {
+  uint8_t key[16];
+  uint64_t offset;
+  uint32_t outSize;
+  uint32_t errSize;
+  uint32_t recordsSize;
+  /// Seconds since the epoch when the report was last added or hit.
+  uint32_t used;
+};
+
+static_assert(sizeof(FileHeader) == 16, "unexpected padding in FileHeader");
+static_assert(sizeof(IndexEntry) == 40, "unexpected padding in IndexEntry");
+
+/**
+ * @brief Returns the name of a value that is unique within its module.
+ */
+std::string qualifiedName(const llvm::Value *val) {
+  const llvm::Function *func = nullptr;
+  if (auto ins = llvm::dyn_cast<llvm::Instruction>(val)) {
+    func = ins->getFunction();
+  } else if (auto arg = llvm::dyn_cast<llvm::Argument>(val)) {
+    func = arg->getParent();
+  }
+  return (func ? func->getName().str() + "::" : "") + variable(val);
+}
+
+/**
+ * @brief Writes what the module-wide analyses know about val.
+ */
+void describe(std::ostringstream &os, const llvm::Value *val, const PointerAnalysis &pa,
+              const ObjectSizeAnalysis &sizes) {
+  if (auto size = sizes.find(val)) {
+    os << "size " << variable(val) << " " << size->elements << " "
+       << (size->symbol ? qualifiedName(size->symbol) : "") << " " << size->scale << " "
+       << size->divisor << " " << size->offset << "\n";
+  }
+  if (val->getType()->isPointerTy()) {
+    // By name: oobcheck deletes the bodies of functions it is done with.
+    os << "pointees " << variable(val);
+    for (auto &name : pa.pointeeNames(val)) {
+      os << " " << name;
+    }
+    os << "\n";
+  }
+}
+
+/**
+ * @brief Writes the definitions of the globals func refers to, directly or
+ * through constant expressions, that seen does not have yet: the facts fold
+ * in their initializers.
+ */
+void describeGlobals(std::ostringstream &os, const llvm::Function &func,
+                     std::set<const llvm::GlobalVariable *> &seen) {
+  std::set<const llvm::Constant *> visited;
+  std::vector<const llvm::Constant *> worklist;
+  for (auto iter = llvm::inst_begin(func), end = llvm::inst_end(func); iter != end; ++iter) {
+    for (auto &op : iter->operands()) {
+      if (auto constant = llvm::dyn_cast<llvm::Constant>(op)) {
+        worklist.push_back(constant);
+      }
+    }
+  }
+  while (!worklist.empty()) {
+    auto constant = worklist.back();
+    worklist.pop_back();
+    if (!visited.insert(constant).second) {
+      continue;
+    }
+    if (auto gv = llvm::dyn_cast<llvm::GlobalVariable>(constant)) {
+      if (seen.insert(gv).second) {
+        std::string def;
+        llvm::raw_string_ostream ss(def);
+        gv->print(ss);
+        os << "global " << ss.str() << "\n";
+      }
+    } else if (!llvm::isa<llvm::GlobalValue>(constant)) {
+      for (auto &op : constant->operands()) {
+        worklist.push_back(llvm::cast<llvm::Constant>(op));
+      }
+    }
+  }
+}
+
+/**
+ * @brief Holds an exclusive lock on the file next to the cache while it
+ * lives, so that processes sharing a cache save one after the other.
+ */
+class SaveLock {
+public:
+  explicit SaveLock(const std::string &path) {
+    _fd = ::open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (_fd < 0) {
+      return;
+    }
+    int ret;
+    while ((ret = flock(_fd, LOCK_EX)) != 0 && errno == EINTR) {
+    }
+    if (ret != 0) {
+      ::close(_fd);
+      _fd = -1;
+    }
+  }
+
+  ~SaveLock() {
+    if (_fd >= 0) {
+      ::close(_fd);
+    }
+  }
+
+  bool locked() const { return _fd >= 0; }
+
+private:
+  int _fd;
+};
+
+uint32_t now() { return (uint32_t)std::time(nullptr); }
+
+} // namespace
+
+ResultCache::ResultCache(std::string path) : _path(std::move(path)) {
+  open();
+}
+
+void ResultCache::open() {
+  _file.reset();
+  _count = 0;
+  auto buffer = llvm::MemoryBuffer::getFile(_path, -1, false);
+  if (!buffer) {
+    return;
+  }
+  auto size = (*buffer)->getBufferSize();
+  FileHeader header;
+  if (size < sizeof(header)) {
+    return;
+  }
+  std::memcpy(&header, (*buffer)->getBufferStart(), sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+      (size - sizeof(header)) / sizeof(IndexEntry) < header.count) {
+    return;
+  }
+  _file = std::move(*buffer);
+  _count = header.count;
+}
+
+ResultCache::Key ResultCache::key(const llvm::Function &func, const PointerAnalysis &pa,
+                                  const ObjectSizeAnalysis &sizes,
+                                  const SummaryTable *summaries) {
+  std::ostringstream os;
+  os << "version " << VERSION << "\n";
+  os << "max-transfers " << TransferBudget << "\n";
+  os << "demand-pa " << DemandDrivenPA << "\n";
+  os << "tiered " << TieredAnalysis << "\n";
+  os << "summaries " << (summaries != nullptr) << "\n";
+  os << "contexts " << CallContexts << "\n";
+  os << "dump " << dumpsFacts(func) << "\n";
+  os << "diagnostics " << !DiagnosticsFile.empty() << "\n";
+  if (!DiagnosticsFile.empty()) {
+    os << "source " << func.getParent()->getSourceFileName() << "\n";
+  }
+  std::set<const llvm::GlobalVariable *> globals;
+  describeGlobals(os, func, globals);
+  for (auto &arg : func.args()) {
+    describe(os, &arg, pa, sizes);
+  }
+  for (auto iter = llvm::inst_begin(func), end = llvm::inst_end(func); iter != end; ++iter) {
+    describe(os, &*iter, pa, sizes);
+    // The IR only refers to the debug locations the records carry.
+    if (!DiagnosticsFile.empty() && iter->getDebugLoc()) {
+      auto &loc = iter->getDebugLoc();
+      os << "loc " << variable(&*iter) << " " << loc->getDirectory().str() << " "
+         << loc->getFilename().str() << " " << loc.getLine() << " " << loc.getCol() << "\n";
+    }
+    auto call = llvm::dyn_cast<llvm::CallInst>(&*iter);
+    if (auto summary = call && summaries ? summaries->find(call) : nullptr) {
+      os << "summary " << variable(call) << " " << summary->ret;
+      for (auto &write : summary->writes) {
+        os << " " << write.first << " " << write.second;
+      }
+      os << "\n";
+      // Re-analyzed per call site, so the whole body matters.
+      if (CallContexts) {
+        std::string callee;
+        llvm::raw_string_ostream ss(callee);
+        call->getCalledFunction()->print(ss);
+        os << ss.str();
+        describeGlobals(os, *call->getCalledFunction(), globals);
+      }
+    }
+  }
+
+  std::string code;
+  llvm::raw_string_ostream ss(code);
+  func.print(ss);
+  ss.flush();
+
+  llvm::MD5 hash;
+  hash.update(os.str());
+  hash.update(code);
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+  Key ret;
+  std::memcpy(ret.data(), &result, ret.size());
+  return ret;
+}
+
+bool ResultCache::lookupFile(const Key &key, std::string &out, std::string &err,
+                             std::string &records, uint32_t *used) const {
+  if (!_file) {
+    return false;
+  }
+  auto start = _file->getBufferStart();
+  auto index = start + sizeof(FileHeader);
+  // Binary search over the mapped index.
+  size_t lo = 0, hi = _count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    IndexEntry entry;
+    std::memcpy(&entry, index + mid * sizeof(IndexEntry), sizeof(entry));
+    int order = std::memcmp(entry.key, key.data(), key.size());
+    if (order < 0) {
+      lo = mid + 1;
+    } else if (order > 0) {
+      hi = mid;
+    } else {
+      if (entry.offset > _file->getBufferSize() ||
+          _file->getBufferSize() - entry.offset <
+              (uint64_t)entry.outSize + entry.errSize + entry.recordsSize) {
+        return false;
+      }
+      out.assign(start + entry.offset, entry.outSize);
+      err.assign(start + entry.offset + entry.outSize, entry.errSize);
+      records.assign(start + entry.offset + entry.outSize + entry.errSize, entry.recordsSize);
+      if (used) {
+        *used = entry.used;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ResultCache::lookup(const Key &key, std::string &out, std::string &err,
+                         std::string &records) const {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto iter = _added.find(key);
+    if (iter != _added.end()) {
+      out = iter->second.out;
+      err = iter->second.err;
+      records = iter->second.records;
+      return true;
+    }
+  }
+  uint32_t used;
+  if (!lookupFile(key, out, err, records, &used)) {
+    return false;
+  }
+  if (now() - used > REFRESH_SECONDS) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _hit.insert(key);
+  }
+  return true;
+}
+
+void ResultCache::insert(const Key &key, std::string out, std::string err,
+                         std::string records) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _added[key] = Report{std::move(out), std::move(err), std::move(records)};
+}
+
+bool ResultCache::save() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_added.empty() && _hit.empty()) {
+    return true;
+  }
+  SaveLock saveLock(_path);
+  if (!saveLock.locked()) {
+    return false;
+  }
+  // Another process may have saved since the file was opened: merge into
+  // what is there now rather than what was there then.
+  open();
+
+  // Merge the entries of the file with the new ones, both sorted by key.
+  struct Entry {
+    Key key;
+    Report report;
+    uint32_t used;
+  };
+  auto time = now();
+  std::vector<Entry> entries;
+  auto added = _added.begin();
+  for (uint32_t i = 0; i < _count; ++i) {
+    IndexEntry entry;
+    std::memcpy(&entry, _file->getBufferStart() + sizeof(FileHeader) + i * sizeof(IndexEntry),
+                sizeof(entry));
+    Key key;
+    std::memcpy(key.data(), entry.key, key.size());
+    for (; added != _added.end() && added->first < key; ++added) {
+      entries.push_back({added->first, added->second, time});
+    }
+    if (added != _added.end() && added->first == key) {
+      continue;
+    }
+    Entry old{key, Report(), 0};
+    if (lookupFile(key, old.report.out, old.report.err, old.report.records, &old.used)) {
+      if (_hit.count(key)) {
+        old.used = time;
+      }
+      entries.push_back(std::move(old));
+    }
+  }
+  for (; added != _added.end(); ++added) {
+    entries.push_back({added->first, added->second, time});
+  }
+
+  // Drop the least recently used entries until the file fits the limit.
+  auto entrySize = [](const Entry &entry) {
+    return sizeof(IndexEntry) + entry.report.out.size() + entry.report.err.size() +
+           entry.report.records.size();
+  };
+  uint64_t total = sizeof(FileHeader);
+  for (auto &entry : entries) {
+    total += entrySize(entry);
+  }
+  uint64_t limit = (uint64_t)CacheLimit << 20;
+  if (limit && total > limit) {
+    std::vector<size_t> order(entries.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return entries[a].used < entries[b].used; });
+    std::vector<bool> dropped(entries.size());
+    for (size_t i = 0; i < order.size() && total > limit; ++i) {
+      dropped[order[i]] = true;
+      total -= entrySize(entries[order[i]]);
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (!dropped[i]) {
+        entries[kept++] = std::move(entries[i]);
+      }
+    }
+    entries.resize(kept);
+  }
+
+  // Write a new file next to the old one, under a name of its own, then
+  // replace the old one with it.
+  int fd;
+  llvm::SmallString<128> temp;
+  if (llvm::sys::fs::createUniqueFile(_path + "-%%%%%%%%.tmp", fd, temp)) {
+    return false;
+  }
+  {
+    llvm::raw_fd_ostream os(fd, true);
+    FileHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.count = entries.size();
+    os.write((const char *)&header, sizeof(header));
+    uint64_t offset = sizeof(header) + entries.size() * sizeof(IndexEntry);
+    for (auto &entry : entries) {
+      IndexEntry index;
+      std::memcpy(index.key, entry.key.data(), entry.key.size());
+      index.offset = offset;
+      index.outSize = entry.report.out.size();
+      index.errSize = entry.report.err.size();
+      index.recordsSize = entry.report.records.size();
+      index.used = entry.used;
+      os.write((const char *)&index, sizeof(index));
+      offset += index.outSize + index.errSize + index.recordsSize;
+    }
+    for (auto &entry : entries) {
+      os << entry.report.out << entry.report.err << entry.report.records;
+    }
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(temp);
+      return false;
+    }
+  }
+  // The old mapping must go before the file is replaced.
+  _file.reset();
+  _count = 0;
+  auto error = llvm::sys::fs::rename(temp, _path);
+  open();
+  if (error) {
+    llvm::sys::fs::remove(temp);
+    return false;
+  }
+  _added.clear();
+  _hit.clear();
+  return true;
+}
+
+} // namespace dataflow
@@ -0,0 +1,314 @@
+#include "ShardedDriver.h"
+#include "ResultCache.h"
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <poll.h>
+#include <signal.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace dataflow {
+
+llvm::cl::opt<unsigned> Shards(
+    "oob-shards",
+    llvm::cl::desc("Analyze functions in this many worker processes instead of threads (0 = use "
+                   "threads). Workers are forked and share the module the coordinator loaded, "
+                   "rather than loading it again"),
+    llvm::cl::init(0));
+
+llvm::cl::opt<unsigned> ShardTimeout(
+    "oob-shard-timeout",
+    llvm::cl::desc("Seconds before unfinished worker processes are killed (0 = no limit)"),
+    llvm::cl::init(0));
+
+namespace {
+
+/// Header of the record a worker sends for each analyzed function, followed
+/// by outSize bytes of facts, errSize bytes of errors and, with
+/// -oob-snapshot, snapshotSize bytes of the function's snapshot.
+struct RecordHeader {
+  uint32_t index;
+  uint32_t outSize;
+  uint32_t errSize;
+  uint32_t snapshotSize;
+};
+
+struct Report {
+  bool done = false;
+  /// Analyzed by the coordinator rather than a worker.
+  bool local = false;
+  std::string out, err, snapshot;
+};
+
+struct Worker {
+  pid_t pid = -1;
+  int fd = -1;
+  std::string buffer;
+  bool timedOut = false;
+};
+
+bool writeAll(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    auto written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+/**
+ * @brief Moves every complete record out of buffer into reports.
+ */
+void parseRecords(std::string &buffer, std::vector<Report> &reports) {
+  size_t pos = 0;
+  RecordHeader header;
+  while (buffer.size() - pos >= sizeof(header)) {
+    std::memcpy(&header, buffer.data() + pos, sizeof(header));
+    size_t size = sizeof(header) + header.outSize + header.errSize + header.snapshotSize;
+    if (buffer.size() - pos < size) {
+      break;
+    }
+    if (header.index < reports.size()) {
+      auto &report = reports[header.index];
+      auto body = buffer.data() + pos + sizeof(header);
+      report.out.assign(body, header.outSize);
+      report.err.assign(body + header.outSize, header.errSize);
+      report.snapshot.assign(body + header.outSize + header.errSize, header.snapshotSize);
+      report.done = true;
+    }
+    pos += size;
+  }
+  buffer.erase(0, pos);
+}
+
+std::string describe(int status, bool timedOut) {
+  if (timedOut) {
+    return "timed out";
+  }
+  if (WIFSIGNALED(status)) {
+    return "was killed by signal " + std::to_string(WTERMSIG(status));
+  }
+  if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+    return "exited with status " + std::to_string(WEXITSTATUS(status));
+  }
+  return "stopped early";
+}
+
+} // namespace
+
+ShardedDriver::ShardedDriver(const PointerAnalysis &pa, const ObjectSizeAnalysis &sizes,
+                             unsigned shards, unsigned timeout)
+    : _pa(pa), _sizes(sizes), _shards(std::max(shards, 1u)), _timeout(timeout) {}
+
+std::vector<std::vector<size_t>> ShardedDriver::partition(
+    const std::vector<const llvm::Function *> &functions, unsigned count) {
+  std::vector<size_t> order(functions.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&functions](size_t lhs, size_t rhs) {
+    return functions[lhs]->getInstructionCount() > functions[rhs]->getInstructionCount();
+  });
+  // Largest function first into the lightest shard.
+  std::vector<std::vector<size_t>> ret(count);
+  std::vector<size_t> load(count, 0);
+  for (auto index : order) {
+    auto lightest = std::min_element(load.begin(), load.end()) - load.begin();
+    ret[lightest].push_back(index);
+    load[lightest] += functions[index]->getInstructionCount() + 1;
+  }
+  for (auto &shard : ret) {
+    std::sort(shard.begin(), shard.end());
+  }
+  return ret;
+}
+
+void ShardedDriver::work(const std::vector<const llvm::Function *> &functions,
+                         const std::vector<size_t> &shard, int fd) {
+  for (auto index : shard) {
+    std::string outBuffer, errBuffer;
+    llvm::raw_string_ostream outStream(outBuffer), errStream(errBuffer);
+    analyzeAndReport(*functions[index], _pa, _sizes, outStream, errStream);
+    outStream.flush();
+    errStream.flush();
+    auto blob = snapshot ? snapshot->take(*functions[index]) : std::string();
+    RecordHeader header{(uint32_t)index, (uint32_t)outBuffer.size(), (uint32_t)errBuffer.size(),
+                        (uint32_t)blob.size()};
+    if (!writeAll(fd, (const char *)&header, sizeof(header)) ||
+        !writeAll(fd, outBuffer.data(), outBuffer.size()) ||
+        !writeAll(fd, errBuffer.data(), errBuffer.size()) ||
+        !writeAll(fd, blob.data(), blob.size())) {
+      return;
+    }
+  }
+}
+
+void ShardedDriver::run(const llvm::Module &module, llvm::StringRef name,
+                        llvm::raw_ostream &out, llvm::raw_ostream &err) {
+  std::vector<const llvm::Function *> functions;
+  for (auto &func : module) {
+    if (!func.isDeclaration()) {
+      functions.push_back(&func);
+    }
+  }
+  std::vector<Report> reports(functions.size());
+  auto shards = partition(functions, _shards);
+
+  // Anything still buffered would be printed again by every worker.
+  out.flush();
+  err.flush();
+  llvm::outs().flush();
+  llvm::errs().flush();
+
+  std::vector<Worker> workers(shards.size());
+  for (size_t i = 0; i < shards.size(); ++i) {
+    int fds[2];
+    if (shards[i].empty() || pipe(fds) != 0) {
+      continue;
+    }
+    auto pid = fork();
+    if (pid == 0) {
+      close(fds[0]);
+      for (auto &worker : workers) {
+        if (worker.fd >= 0) {
+          close(worker.fd);
+        }
+      }
+      work(functions, shards[i], fds[1]);
+      close(fds[1]);
+      // Skip destructors and atexit handlers, they belong to the coordinator.
+      _exit(0);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+      close(fds[0]);
+      continue;
+    }
+    workers[i].pid = pid;
+    workers[i].fd = fds[0];
+  }
+
+  // Shards that could not be forked are analyzed right here.
+  for (size_t i = 0; i < shards.size(); ++i) {
+    if (workers[i].pid >= 0) {
+      continue;
+    }
+    for (auto index : shards[i]) {
+      llvm::raw_string_ostream outStream(reports[index].out), errStream(reports[index].err);
+      analyzeAndReport(*functions[index], _pa, _sizes, outStream, errStream);
+      outStream.flush();
+      errStream.flush();
+      reports[index].done = true;
+      reports[index].local = true;
+    }
+  }
+
+  using Clock = std::chrono::steady_clock;
+  auto deadline = Clock::now() + std::chrono::seconds(_timeout);
+  while (true) {
+    std::vector<pollfd> polls;
+    std::vector<Worker *> polled;
+    for (auto &worker : workers) {
+      if (worker.fd >= 0) {
+        polls.push_back({worker.fd, POLLIN, 0});
+        polled.push_back(&worker);
+      }
+    }
+    if (polls.empty()) {
+      break;
+    }
+    int wait = -1;
+    if (_timeout) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+      if (left <= 0) {
+        for (auto worker : polled) {
+          kill(worker->pid, SIGKILL);
+          close(worker->fd);
+          worker->fd = -1;
+          worker->timedOut = true;
+        }
+        break;
+      }
+      wait = (int)left;
+    }
+    if (poll(polls.data(), polls.size(), wait) < 0 && errno != EINTR) {
+      break;
+    }
+    for (size_t i = 0; i < polls.size(); ++i) {
+      if (!polls[i].revents) {
+        continue;
+      }
+      auto worker = polled[i];
+      char chunk[1 << 16];
+      auto size = read(worker->fd, chunk, sizeof(chunk));
+      if (size > 0) {
+        worker->buffer.append(chunk, size);
+        parseRecords(worker->buffer, reports);
+      } else if (size == 0 || errno != EINTR) {
+        close(worker->fd);
+        worker->fd = -1;
+      }
+    }
+  }
+
+  // Merge in source order. What the workers added to their copy of the
+  // cache, of the triage counts and of the snapshot is lost with them, so
+  // add it again here.
+  for (size_t i = 0; i < functions.size(); ++i) {
+    if (reports[i].done) {
+      out << "Running " << name << " on " << functions[i]->getName() << "\n" << reports[i].out;
+      err << reports[i].err;
+      if (reports[i].local) {
+        continue;
+      }
+      if (snapshot) {
+        snapshot->insert(*functions[i], std::move(reports[i].snapshot));
+      }
+      auto kind = triage(*functions[i], _sizes);
+      triaged.add(kind);
+      bool timedOut = TimeBudget && reports[i].err.find(degradedMessage) != std::string::npos;
+      // The workers write their diagnostics themselves, so there are no
+      // records to cache with the report.
+      if (cache && kind == Triage::NeedsDataflow && !timedOut && !diagnostics) {
+        cache->insert(ResultCache::key(*functions[i], _pa, _sizes, summaries), reports[i].out,
+                      reports[i].err, "");
+      }
+    }
+  }
+
+  for (size_t i = 0; i < workers.size(); ++i) {
+    if (workers[i].pid < 0) {
+      continue;
+    }
+    if (workers[i].fd >= 0) {
+      close(workers[i].fd);
+    }
+    int status = 0;
+    while (waitpid(workers[i].pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    std::string missing;
+    for (auto index : shards[i]) {
+      if (!reports[index].done) {
+        missing += (missing.empty() ? "" : ", ") + functions[index]->getName().str();
+      }
+    }
+    if (!missing.empty()) {
+      err << "Shard " << i << " " << describe(status, workers[i].timedOut)
+          << "; not analyzed: " << missing << "\n";
+    }
+  }
+}
+
+} // namespace dataflow
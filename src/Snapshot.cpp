@@ -0,0 +1,812 @@
+#include "Snapshot.h"
+#include "OOBChecker.h"
+#include "Utils.h"
+
+#include <llvm/IR/DebugLoc.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+namespace dataflow {
+
+llvm::cl::opt<std::string> SnapshotFile(
+    "oob-snapshot",
+    llvm::cl::desc("Write the converged facts, the object sizes and the value numbers of the "
+                   "run to this file, for oobquery"),
+    llvm::cl::value_desc("filename"));
+
+namespace {
+
+const char MAGIC[8] = {'O', 'O', 'B', 'S', 'N', 'A', 'P', 'S'};
+const uint32_t VERSION = 1;
+
+// Layout of the file, in native byte order:
+//   FileHeader, ModuleEntry[moduleCount], FunctionEntry[functionCount]
+//   sorted by name, SizeEntry[sizeCount], ValueNumberEntry[valueNumberCount],
+//   IntervalEntry[intervalCount], the function blobs, then the strings.
+// Strings are referred to by their position in the strings, and intervals
+// by their index.
+struct Str {
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint32_t moduleCount;
+  uint32_t functionCount;
+  uint32_t sizeCount;
+  uint32_t valueNumberCount;
+  uint32_t intervalCount;
+  uint32_t reserved2;
+  uint64_t modules;
+  uint64_t functions;
+  uint64_t sizes;
+  uint64_t valueNumbers;
+  uint64_t intervals;
+  uint64_t strings;
+  uint64_t stringsSize;
+};
+
+struct ModuleEntry {
+  Str source;
+  uint32_t firstSize;
+  uint32_t sizeCount;
+  uint32_t firstValueNumber;
+  uint32_t valueNumberCount;
+};
+
+enum : uint32_t { Fixpoint = 1, Degraded = 2 };
+
+struct FunctionEntry {
+  Str name;
+  uint32_t module;
+  uint32_t flags;
+  /// Position and size of the blob in the file.
+  uint64_t blob;
+  uint64_t blobSize;
+};
+
+/// An unknown domain has intervalCount UNKNOWN.
+const uint32_t UNKNOWN = UINT32_MAX;
+
+struct SizeEntry {
+  Str value;
+  Str symbol;
+  int32_t scale;
+  int32_t divisor;
+  int32_t offset;
+  uint32_t firstInterval;
+  uint32_t intervalCount;
+  uint32_t reserved;
+};
+
+struct ValueNumberEntry {
+  Str variable;
+  Str representative;
+};
+
+struct IntervalEntry {
+  int32_t lo;
+  int32_t hi;
+};
+
+// Layout of a function blob, with positions relative to its start:
+//   BlobHeader, then the tables it points to. Strings are referred to by
+//   their position in the strings of the blob.
+struct BlobStr {
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct BlobHeader {
+  uint32_t flags, reserved;
+  uint32_t blockCount, instructionCount, keyCount, domainCount;
+  uint32_t intervalCount, factCount, constantCount, stringsSize;
+  uint32_t blocks, instructions, keys, domains;
+  uint32_t intervals, facts, constants, strings;
+};
+
+struct BlockEntry {
+  BlobStr name;
+  uint32_t firstInstruction;
+  uint32_t instructionCount;
+};
+
+/// The facts of an instruction are those before it, changed by its IN facts
+/// and then by its OUT facts.
+struct InstructionEntry {
+  BlobStr name;
+  uint32_t block;
+  uint32_t line;
+  uint32_t firstIn, inCount;
+  uint32_t firstOut, outCount;
+};
+
+struct DomainEntry {
+  uint32_t firstInterval;
+  uint32_t intervalCount;
+};
+
+/// A fact key with its new domain, 0 if the key was removed, else the index
+/// of the domain plus one.
+struct FactEntry {
+  uint32_t key;
+  uint32_t domain;
+};
+
+static_assert(sizeof(FileHeader) == 96, "unexpected padding in FileHeader");
+static_assert(sizeof(ModuleEntry) == 32, "unexpected padding in ModuleEntry");
+static_assert(sizeof(FunctionEntry) == 40, "unexpected padding in FunctionEntry");
+static_assert(sizeof(SizeEntry) == 56, "unexpected padding in SizeEntry");
+static_assert(sizeof(BlobHeader) == 72, "unexpected padding in BlobHeader");
+static_assert(sizeof(InstructionEntry) == 32, "unexpected padding in InstructionEntry");
+
+template <typename T> void put(std::string &buffer, const T &val) {
+  buffer.append((const char *)&val, sizeof(val));
+}
+
+template <typename T> void put(std::string &buffer, const std::vector<T> &vals) {
+  buffer.append((const char *)vals.data(), vals.size() * sizeof(T));
+}
+
+/**
+ * @brief Reads the count entries of type T at pos in data.
+ * @return false if they do not fit into data.
+ */
+template <typename T>
+bool readTable(llvm::StringRef data, uint64_t pos, uint64_t count, std::vector<T> &ret) {
+  if (pos > data.size() || (data.size() - pos) / sizeof(T) < count) {
+    return false;
+  }
+  ret.resize(count);
+  std::memcpy((void *)ret.data(), data.data() + pos, count * sizeof(T));
+  return true;
+}
+
+template <typename T> bool readEntry(llvm::StringRef data, uint64_t pos, T &ret) {
+  if (pos > data.size() || data.size() - pos < sizeof(T)) {
+    return false;
+  }
+  std::memcpy((void *)&ret, data.data() + pos, sizeof(T));
+  return true;
+}
+
+/**
+ * @brief Returns the name of val that is unique within its module, like the
+ * points-to analysis qualifies it.
+ */
+std::string qualifiedName(const llvm::Value *val) {
+  std::string name = llvm::StringRef(variable(val)).trim().str();
+  if (auto arg = llvm::dyn_cast<llvm::Argument>(val)) {
+    // variable() prints the type first for arguments.
+    name = "%" + (arg->hasName() ? arg->getName().str() : std::to_string(arg->getArgNo()));
+    return arg->getParent()->getName().str() + "::" + name;
+  }
+  if (auto ins = llvm::dyn_cast<llvm::Instruction>(val)) {
+    return ins->getFunction()->getName().str() + "::" + name;
+  }
+  return name;
+}
+
+std::string blockName(const llvm::BasicBlock &block) {
+  std::string ret;
+  llvm::raw_string_ostream os(ret);
+  block.printAsOperand(os, false);
+  return os.str();
+}
+
+/**
+ * @brief Encodes the facts of one function into a blob.
+ */
+class BlobBuilder {
+public:
+  std::string build(const llvm::Function &func, const AnalysisContext &context);
+
+private:
+  std::vector<BlockEntry> _blocks;
+  std::vector<InstructionEntry> _instructions;
+  std::vector<BlobStr> _keys;
+  std::vector<DomainEntry> _domains;
+  std::vector<IntervalEntry> _intervals;
+  std::vector<FactEntry> _facts, _constants;
+  std::string _strings;
+  std::unordered_map<std::string, uint32_t> _keyIds, _domainIds;
+  std::string _encoded;
+
+  BlobStr string(llvm::StringRef str) {
+    BlobStr ret{(uint32_t)_strings.size(), (uint32_t)str.size()};
+    _strings.append(str.data(), str.size());
+    return ret;
+  }
+
+  uint32_t key(const std::string &name) {
+    auto iter = _keyIds.find(name);
+    if (iter != _keyIds.end()) {
+      return iter->second;
+    }
+    uint32_t ret = _keys.size();
+    _keys.push_back(string(llvm::StringRef(name).trim()));
+    _keyIds.emplace(name, ret);
+    return ret;
+  }
+
+  /// Index of val plus one.
+  uint32_t domain(const IntervalDomain &val) {
+    _encoded.clear();
+    for (auto &interval : val) {
+      put(_encoded, IntervalEntry{interval.lower(), interval.upper()});
+    }
+    if (val.isUnknown()) {
+      _encoded = "?";
+    }
+    auto iter = _domainIds.find(_encoded);
+    if (iter != _domainIds.end()) {
+      return iter->second;
+    }
+    DomainEntry entry{(uint32_t)_intervals.size(), UNKNOWN};
+    if (!val.isUnknown()) {
+      entry.intervalCount = val.size();
+      for (auto &interval : val) {
+        _intervals.push_back({interval.lower(), interval.upper()});
+      }
+    }
+    _domains.push_back(entry);
+    uint32_t ret = _domains.size();
+    _domainIds.emplace(_encoded, ret);
+    return ret;
+  }
+
+  /**
+   * @brief Appends what changes from facts to next.
+   */
+  void diff(const FactMap &facts, const FactMap &next) {
+    for (auto &fact : next) {
+      if (!facts.contains(fact.first, fact.second)) {
+        _facts.push_back({key(fact.first), domain(fact.second)});
+      }
+    }
+    for (auto &fact : facts) {
+      if (!next.contains(fact.first)) {
+        _facts.push_back({key(fact.first), 0});
+      }
+    }
+  }
+};
+
+std::string BlobBuilder::build(const llvm::Function &func, const AnalysisContext &context) {
+  const FactMap empty;
+  for (auto &block : func) {
+    _blocks.push_back({string(blockName(block)), (uint32_t)_instructions.size(), 0});
+    auto *last = &empty;
+    for (auto &ins : block) {
+      InstructionEntry entry{};
+      entry.name = string(llvm::StringRef(variable(&ins)).trim());
+      entry.block = _blocks.size() - 1;
+      entry.line = ins.getDebugLoc() ? ins.getDebugLoc().getLine() : 0;
+      auto in = context.in.find(&ins);
+      auto out = context.out.find(&ins);
+      if (in != context.in.end() && out != context.out.end()) {
+        entry.firstIn = _facts.size();
+        diff(*last, in->second);
+        entry.inCount = _facts.size() - entry.firstIn;
+        entry.firstOut = _facts.size();
+        diff(in->second, out->second);
+        entry.outCount = _facts.size() - entry.firstOut;
+        last = &out->second;
+      }
+      _instructions.push_back(entry);
+      _blocks.back().instructionCount += 1;
+    }
+  }
+  for (auto &fact : context.constants) {
+    _constants.push_back({key(fact.first), domain(fact.second)});
+  }
+
+  BlobHeader header{};
+  // Tells a function whose fixpoint ran apart from one the tiers decided.
+  header.flags = 0;
+  if (!context.in.empty()) {
+    header.flags |= Fixpoint;
+  }
+  if (context.degraded) {
+    header.flags |= Degraded;
+  }
+  header.blockCount = _blocks.size();
+  header.instructionCount = _instructions.size();
+  header.keyCount = _keys.size();
+  header.domainCount = _domains.size();
+  header.intervalCount = _intervals.size();
+  header.factCount = _facts.size();
+  header.constantCount = _constants.size();
+  header.stringsSize = _strings.size();
+  header.blocks = sizeof(header);
+  header.instructions = header.blocks + _blocks.size() * sizeof(BlockEntry);
+  header.keys = header.instructions + _instructions.size() * sizeof(InstructionEntry);
+  header.domains = header.keys + _keys.size() * sizeof(BlobStr);
+  header.intervals = header.domains + _domains.size() * sizeof(DomainEntry);
+  header.facts = header.intervals + _intervals.size() * sizeof(IntervalEntry);
+  header.constants = header.facts + _facts.size() * sizeof(FactEntry);
+  header.strings = header.constants + _constants.size() * sizeof(FactEntry);
+
+  std::string ret;
+  ret.reserve(header.strings + _strings.size());
+  put(ret, header);
+  put(ret, _blocks);
+  put(ret, _instructions);
+  put(ret, _keys);
+  put(ret, _domains);
+  put(ret, _intervals);
+  put(ret, _facts);
+  put(ret, _constants);
+  ret += _strings;
+  return ret;
+}
+
+/**
+ * @brief The tables of a blob, read and checked.
+ */
+struct Blob {
+  BlobHeader header;
+  llvm::StringRef data;
+  std::vector<BlockEntry> blocks;
+  std::vector<InstructionEntry> instructions;
+  std::vector<BlobStr> keys;
+  std::vector<DomainEntry> domains;
+  std::vector<IntervalEntry> intervals;
+
+  bool read(llvm::StringRef blob) {
+    data = blob;
+    return readEntry(data, 0, header) && header.strings <= data.size() &&
+           data.size() - header.strings >= header.stringsSize &&
+           readTable(data, header.blocks, header.blockCount, blocks) &&
+           readTable(data, header.instructions, header.instructionCount, instructions) &&
+           readTable(data, header.keys, header.keyCount, keys) &&
+           readTable(data, header.domains, header.domainCount, domains) &&
+           readTable(data, header.intervals, header.intervalCount, intervals);
+  }
+
+  std::string string(BlobStr str) const {
+    if (str.offset > header.stringsSize || header.stringsSize - str.offset < str.size) {
+      return "";
+    }
+    return data.substr(header.strings + str.offset, str.size).str();
+  }
+
+  /**
+   * @brief Applies count facts starting at first to facts.
+   */
+  bool apply(uint32_t table, uint32_t tableCount, uint32_t first, uint32_t count,
+             FactMap &facts) const {
+    std::vector<FactEntry> entries;
+    if (first > tableCount || tableCount - first < count ||
+        !readTable(data, table + (uint64_t)first * sizeof(FactEntry), count, entries)) {
+      return false;
+    }
+    for (auto &entry : entries) {
+      if (entry.key >= keys.size() || entry.domain > domains.size()) {
+        return false;
+      }
+      auto name = string(keys[entry.key]);
+      if (!entry.domain) {
+        facts.erase(name);
+        continue;
+      }
+      auto &domain = domains[entry.domain - 1];
+      if (domain.intervalCount == UNKNOWN) {
+        facts[name] = IntervalDomain::UNINIT();
+        continue;
+      }
+      if (domain.firstInterval > intervals.size() ||
+          intervals.size() - domain.firstInterval < domain.intervalCount) {
+        return false;
+      }
+      auto val = IntervalDomain::EMPTY();
+      for (uint32_t i = 0; i < domain.intervalCount; ++i) {
+        auto &interval = intervals[domain.firstInterval + i];
+        val.insert(Interval(interval.lo, interval.hi));
+      }
+      facts[name] = val;
+    }
+    return true;
+  }
+};
+
+} // namespace
+
+SnapshotWriter::SnapshotWriter(std::string path) : _path(std::move(path)) {}
+
+std::unique_ptr<SnapshotWriter> SnapshotWriter::open() {
+  if (SnapshotFile.empty()) {
+    return nullptr;
+  }
+  return std::make_unique<SnapshotWriter>(SnapshotFile);
+}
+
+void SnapshotWriter::addModule(const llvm::Module &module, const PointerAnalysis &pa,
+                               const ObjectSizeAnalysis &sizes) {
+  Module entry;
+  entry.source = module.getSourceFileName();
+  sizes.forEach([&entry](const llvm::Value *val, const ObjectSize &size) {
+    entry.sizes.push_back({qualifiedName(val), size.symbol ? qualifiedName(size.symbol) : "",
+                           size.elements, size.scale, size.divisor, size.offset});
+  });
+  std::sort(entry.sizes.begin(), entry.sizes.end(),
+            [](const Module::Size &lhs, const Module::Size &rhs) { return lhs.value < rhs.value; });
+  for (auto &merged : pa.valueNumbers()) {
+    entry.valueNumbers.emplace_back(llvm::StringRef(merged.first).trim().str(),
+                                    llvm::StringRef(merged.second).trim().str());
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  // A module allocated where a finished one was replaces it.
+  _moduleIds[&module] = _modules.size();
+  _modules.push_back(std::move(entry));
+}
+
+void SnapshotWriter::add(const llvm::Function &func, const AnalysisContext &context) {
+  BlobBuilder builder;
+  auto blob = builder.build(func, context);
+  bool known;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    known = _moduleIds.count(func.getParent());
+  }
+  if (!known) {
+    addModule(*func.getParent(), context.pa, context.sizes);
+  }
+  append(func, std::move(blob));
+}
+
+void SnapshotWriter::append(const llvm::Function &func, std::string blob) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto iter = _moduleIds.find(func.getParent());
+  if (iter == _moduleIds.end()) {
+    return;
+  }
+  _functions.push_back({func.getName().str(), iter->second, std::move(blob)});
+}
+
+std::string SnapshotWriter::take(const llvm::Function &func) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (auto iter = _functions.rbegin(); iter != _functions.rend(); ++iter) {
+    if (iter->name == func.getName()) {
+      auto ret = std::move(iter->blob);
+      _functions.erase(std::next(iter).base());
+      return ret;
+    }
+  }
+  return "";
+}
+
+void SnapshotWriter::insert(const llvm::Function &func, std::string blob) {
+  if (blob.size() < sizeof(BlobHeader)) {
+    return;
+  }
+  append(func, std::move(blob));
+}
+
+bool SnapshotWriter::save() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::sort(_functions.begin(), _functions.end(), [](const Function &lhs, const Function &rhs) {
+    return std::tie(lhs.name, lhs.module) < std::tie(rhs.name, rhs.module);
+  });
+
+  std::string strings;
+  auto string = [&strings](llvm::StringRef str) {
+    Str ret{strings.size(), str.size()};
+    strings.append(str.data(), str.size());
+    return ret;
+  };
+  std::vector<ModuleEntry> modules;
+  std::vector<SizeEntry> sizes;
+  std::vector<ValueNumberEntry> valueNumbers;
+  std::vector<IntervalEntry> intervals;
+  for (auto &module : _modules) {
+    ModuleEntry entry{string(module.source), (uint32_t)sizes.size(), (uint32_t)module.sizes.size(),
+                      (uint32_t)valueNumbers.size(), (uint32_t)module.valueNumbers.size()};
+    modules.push_back(entry);
+    for (auto &size : module.sizes) {
+      SizeEntry sizeEntry{string(size.value), string(size.symbol), size.scale, size.divisor,
+                          size.offset, (uint32_t)intervals.size(), UNKNOWN, 0};
+      if (!size.elements.isUnknown()) {
+        sizeEntry.intervalCount = size.elements.size();
+        for (auto &interval : size.elements) {
+          intervals.push_back({interval.lower(), interval.upper()});
+        }
+      }
+      sizes.push_back(sizeEntry);
+    }
+    for (auto &merged : module.valueNumbers) {
+      valueNumbers.push_back({string(merged.first), string(merged.second)});
+    }
+  }
+
+  FileHeader header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.moduleCount = modules.size();
+  header.functionCount = _functions.size();
+  header.sizeCount = sizes.size();
+  header.valueNumberCount = valueNumbers.size();
+  header.intervalCount = intervals.size();
+  header.modules = sizeof(header);
+  header.functions = header.modules + modules.size() * sizeof(ModuleEntry);
+  header.sizes = header.functions + _functions.size() * sizeof(FunctionEntry);
+  header.valueNumbers = header.sizes + sizes.size() * sizeof(SizeEntry);
+  header.intervals = header.valueNumbers + valueNumbers.size() * sizeof(ValueNumberEntry);
+
+  // Blobs start 8-byte aligned.
+  auto align = [](uint64_t pos) { return (pos + 7) & ~(uint64_t)7; };
+  std::vector<FunctionEntry> functions;
+  uint64_t pos = align(header.intervals + intervals.size() * sizeof(IntervalEntry));
+  for (auto &func : _functions) {
+    FunctionEntry entry{string(func.name), func.module, 0, pos, func.blob.size()};
+    std::memcpy(&entry.flags, func.blob.data(), sizeof(entry.flags));
+    functions.push_back(entry);
+    pos = align(pos + entry.blobSize);
+  }
+  header.strings = pos;
+  header.stringsSize = strings.size();
+
+  std::error_code error;
+  llvm::raw_fd_ostream os(_path, error);
+  if (error) {
+    return false;
+  }
+  std::string head;
+  put(head, header);
+  put(head, modules);
+  put(head, functions);
+  put(head, sizes);
+  put(head, valueNumbers);
+  put(head, intervals);
+  os << head;
+  const char padding[8] = {};
+  pos = head.size();
+  for (size_t i = 0; i < functions.size(); ++i) {
+    os.write(padding, functions[i].blob - pos);
+    os << _functions[i].blob;
+    pos = functions[i].blob + functions[i].blobSize;
+  }
+  os.write(padding, header.strings - pos);
+  os << strings;
+  os.close();
+  return !os.has_error();
+}
+
+std::unique_ptr<Snapshot> Snapshot::open(const std::string &path, std::string &error) {
+  auto buffer = llvm::MemoryBuffer::getFile(path, -1, false);
+  if (!buffer) {
+    error = buffer.getError().message();
+    return nullptr;
+  }
+  auto data = (*buffer)->getBuffer();
+  FileHeader header;
+  if (!readEntry(data, 0, header) || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    error = "not a snapshot";
+    return nullptr;
+  }
+  if (header.version != VERSION) {
+    error = "snapshot version " + std::to_string(header.version) + ", expected " +
+            std::to_string(VERSION);
+    return nullptr;
+  }
+  auto fits = [&data](uint64_t pos, uint64_t count, uint64_t size) {
+    return pos <= data.size() && (data.size() - pos) / size >= count;
+  };
+  if (!fits(header.modules, header.moduleCount, sizeof(ModuleEntry)) ||
+      !fits(header.functions, header.functionCount, sizeof(FunctionEntry)) ||
+      !fits(header.sizes, header.sizeCount, sizeof(SizeEntry)) ||
+      !fits(header.valueNumbers, header.valueNumberCount, sizeof(ValueNumberEntry)) ||
+      !fits(header.intervals, header.intervalCount, sizeof(IntervalEntry)) ||
+      !fits(header.strings, header.stringsSize, 1)) {
+    error = "truncated snapshot";
+    return nullptr;
+  }
+  return std::unique_ptr<Snapshot>(new Snapshot(std::move(*buffer)));
+}
+
+namespace {
+
+FileHeader headerOf(const llvm::MemoryBuffer &file) {
+  FileHeader ret;
+  std::memcpy(&ret, file.getBufferStart(), sizeof(ret));
+  return ret;
+}
+
+std::string stringOf(const llvm::MemoryBuffer &file, const FileHeader &header, Str str) {
+  if (str.offset > header.stringsSize || header.stringsSize - str.offset < str.size) {
+    return "";
+  }
+  return file.getBuffer().substr(header.strings + str.offset, str.size).str();
+}
+
+IntervalDomain domainOf(const llvm::MemoryBuffer &file, const FileHeader &header,
+                        uint32_t first, uint32_t count) {
+  if (count == UNKNOWN) {
+    return IntervalDomain::UNINIT();
+  }
+  auto ret = IntervalDomain::EMPTY();
+  std::vector<IntervalEntry> intervals;
+  if (first <= header.intervalCount && header.intervalCount - first >= count &&
+      readTable(file.getBuffer(), header.intervals + (uint64_t)first * sizeof(IntervalEntry),
+                count, intervals)) {
+    for (auto &interval : intervals) {
+      ret.insert(Interval(interval.lo, interval.hi));
+    }
+  }
+  return ret;
+}
+
+} // namespace
+
+std::vector<std::string> Snapshot::modules() const {
+  auto header = headerOf(*_file);
+  std::vector<ModuleEntry> entries;
+  readTable(_file->getBuffer(), header.modules, header.moduleCount, entries);
+  std::vector<std::string> ret;
+  for (auto &entry : entries) {
+    ret.push_back(stringOf(*_file, header, entry.source));
+  }
+  return ret;
+}
+
+std::vector<Snapshot::Function> Snapshot::functions() const {
+  auto header = headerOf(*_file);
+  std::vector<FunctionEntry> entries;
+  readTable(_file->getBuffer(), header.functions, header.functionCount, entries);
+  std::vector<Function> ret;
+  for (uint32_t i = 0; i < entries.size(); ++i) {
+    ret.push_back({stringOf(*_file, header, entries[i].name), entries[i].module,
+                   (entries[i].flags & Fixpoint) != 0, (entries[i].flags & Degraded) != 0, i});
+  }
+  return ret;
+}
+
+std::vector<Snapshot::Function> Snapshot::find(llvm::StringRef name) const {
+  auto header = headerOf(*_file);
+  auto data = _file->getBuffer();
+  auto nameAt = [&](uint32_t index) {
+    FunctionEntry entry;
+    std::memcpy(&entry, data.data() + header.functions + index * sizeof(FunctionEntry),
+                sizeof(entry));
+    return std::make_pair(stringOf(*_file, header, entry.name), entry);
+  };
+  // Binary search over the mapped index for the first function called name.
+  uint32_t lo = 0, hi = header.functionCount;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (nameAt(mid).first < name) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  std::vector<Function> ret;
+  for (; lo < header.functionCount; ++lo) {
+    auto found = nameAt(lo);
+    if (found.first != name) {
+      break;
+    }
+    ret.push_back({found.first, found.second.module, (found.second.flags & Fixpoint) != 0,
+                   (found.second.flags & Degraded) != 0, lo});
+  }
+  return ret;
+}
+
+namespace {
+
+bool readBlob(const llvm::MemoryBuffer &file, uint32_t index, Blob &blob) {
+  auto header = headerOf(file);
+  FunctionEntry entry;
+  if (index >= header.functionCount ||
+      !readEntry(file.getBuffer(), header.functions + index * sizeof(FunctionEntry), entry) ||
+      entry.blob > file.getBufferSize() || file.getBufferSize() - entry.blob < entry.blobSize) {
+    return false;
+  }
+  return blob.read(file.getBuffer().substr(entry.blob, entry.blobSize));
+}
+
+} // namespace
+
+bool Snapshot::instructions(const Function &func, std::vector<Instruction> &ret) const {
+  Blob blob;
+  if (!readBlob(*_file, func.index, blob)) {
+    return false;
+  }
+  ret.clear();
+  for (auto &entry : blob.instructions) {
+    if (entry.block >= blob.blocks.size()) {
+      return false;
+    }
+    ret.push_back({blob.string(entry.name), blob.string(blob.blocks[entry.block].name), entry.line});
+  }
+  return true;
+}
+
+bool Snapshot::facts(const Function &func, uint32_t instruction, FactMap &in,
+                     FactMap &out) const {
+  Blob blob;
+  if (!readBlob(*_file, func.index, blob) || instruction >= blob.instructions.size()) {
+    return false;
+  }
+  auto &header = blob.header;
+  auto block = blob.instructions[instruction].block;
+  if (block >= blob.blocks.size()) {
+    return false;
+  }
+  // Replay the block from its entry up to the instruction.
+  FactMap facts;
+  for (auto i = blob.blocks[block].firstInstruction; i < instruction; ++i) {
+    auto &entry = blob.instructions[i];
+    if (!blob.apply(header.facts, header.factCount, entry.firstIn, entry.inCount, facts) ||
+        !blob.apply(header.facts, header.factCount, entry.firstOut, entry.outCount, facts)) {
+      return false;
+    }
+  }
+  auto &entry = blob.instructions[instruction];
+  if (!blob.apply(header.facts, header.factCount, entry.firstIn, entry.inCount, facts)) {
+    return false;
+  }
+  in = facts;
+  if (!blob.apply(header.facts, header.factCount, entry.firstOut, entry.outCount, facts)) {
+    return false;
+  }
+  out = std::move(facts);
+  return true;
+}
+
+bool Snapshot::constants(const Function &func, FactMap &ret) const {
+  Blob blob;
+  return readBlob(*_file, func.index, blob) &&
+         blob.apply(blob.header.constants, blob.header.constantCount, 0,
+                    blob.header.constantCount, ret);
+}
+
+std::vector<Snapshot::Size> Snapshot::sizes(uint32_t module) const {
+  auto header = headerOf(*_file);
+  ModuleEntry moduleEntry;
+  std::vector<SizeEntry> entries;
+  std::vector<Size> ret;
+  if (module >= header.moduleCount ||
+      !readEntry(_file->getBuffer(), header.modules + module * sizeof(ModuleEntry), moduleEntry) ||
+      moduleEntry.firstSize > header.sizeCount ||
+      header.sizeCount - moduleEntry.firstSize < moduleEntry.sizeCount ||
+      !readTable(_file->getBuffer(), header.sizes + moduleEntry.firstSize * sizeof(SizeEntry),
+                 moduleEntry.sizeCount, entries)) {
+    return ret;
+  }
+  for (auto &entry : entries) {
+    ret.push_back({stringOf(*_file, header, entry.value), stringOf(*_file, header, entry.symbol),
+                   domainOf(*_file, header, entry.firstInterval, entry.intervalCount),
+                   entry.scale, entry.divisor, entry.offset});
+  }
+  return ret;
+}
+
+std::vector<std::pair<std::string, std::string>> Snapshot::valueNumbers(uint32_t module) const {
+  auto header = headerOf(*_file);
+  ModuleEntry moduleEntry;
+  std::vector<ValueNumberEntry> entries;
+  std::vector<std::pair<std::string, std::string>> ret;
+  if (module >= header.moduleCount ||
+      !readEntry(_file->getBuffer(), header.modules + module * sizeof(ModuleEntry), moduleEntry) ||
+      moduleEntry.firstValueNumber > header.valueNumberCount ||
+      header.valueNumberCount - moduleEntry.firstValueNumber < moduleEntry.valueNumberCount ||
+      !readTable(_file->getBuffer(),
+                 header.valueNumbers + moduleEntry.firstValueNumber * sizeof(ValueNumberEntry),
+                 moduleEntry.valueNumberCount, entries)) {
+    return ret;
+  }
+  for (auto &entry : entries) {
+    ret.emplace_back(stringOf(*_file, header, entry.variable),
+                     stringOf(*_file, header, entry.representative));
+  }
+  return ret;
+}
+
+} // namespace dataflow
@@ -0,0 +1,369 @@
+#include "ContextCache.h"
+#include "FunctionSummary.h"
+#include "OOBChecker.h"
+#include "RangeQuery.h"
+#include "Utils.h"
+
+#include <llvm/IR/Dominators.h>
+#include <unordered_map>
+
+namespace dataflow
+{
+  llvm::cl::opt<bool> TieredAnalysis(
+      "oob-tiered",
+      llvm::cl::desc("Decide accesses with constant propagation first, and run the interval "
+                     "analysis only on the slice of the remaining ones"),
+      llvm::cl::init(true));
+
+  namespace
+  {
+    /**
+     * @brief Is val a single, finite constant?
+     */
+    bool isExact(const IntervalDomain &val)
+    {
+      return !val.isUnknown() && !val.isEmpty() && val.lower() == val.upper() &&
+             val.lower() != Interval::INT_NEG_INF && val.upper() != Interval::INT_INF;
+    }
+
+    /**
+     * @brief Sparse constant and copy propagation, evaluated on demand.
+     *
+     * Follows SSA def-use chains backwards from the value asked for. Loads
+     * are resolved through integer allocas that do not escape: if every store
+     * to one writes the same constant and a store dominates the load, the load
+     * reads that constant. A call returns a constant if the summary of the
+     * callee says so, in the context of the call if context-sensitive.
+     * Arguments are constant if the context of the function says so.
+     */
+    class ConstantResolver
+    {
+    public:
+      ConstantResolver(const llvm::Function &func, AnalysisContext &context)
+          : _dominators(const_cast<llvm::Function &>(func)), _context(context),
+            _constants(context.constants) {}
+
+      /**
+       * @return true if val is a known constant, which is then in constants.
+       */
+      bool resolve(const llvm::Value *val)
+      {
+        if (llvm::isa<llvm::ConstantInt>(val))
+        {
+          return true;
+        }
+        auto memo = _done.find(val);
+        if (memo != _done.end())
+        {
+          return memo->second;
+        }
+        // Cycles through phis are not resolved.
+        _done[val] = false;
+        IntervalDomain ret = IntervalDomain::UNINIT();
+        if (auto *cast = llvm::dyn_cast<llvm::CastInst>(val))
+        {
+          if (cast->getType()->isIntegerTy() && resolve(cast->getOperand(0)))
+          {
+            ret = _constants.getOrExtract(cast->getOperand(0));
+          }
+        }
+        else if (auto *binOp = llvm::dyn_cast<llvm::BinaryOperator>(val))
+        {
+          if (resolve(binOp->getOperand(0)) && resolve(binOp->getOperand(1)))
+          {
+            ret = eval(binOp, _constants);
+          }
+        }
+        else if (auto *phi = llvm::dyn_cast<llvm::PHINode>(val))
+        {
+          ret = resolvePhi(phi);
+        }
+        else if (auto *load = llvm::dyn_cast<llvm::LoadInst>(val))
+        {
+          ret = resolveLoad(load);
+        }
+        else if (auto *call = llvm::dyn_cast<llvm::CallInst>(val))
+        {
+          ret = resolveCall(call);
+        }
+        else if (llvm::isa<llvm::Argument>(val))
+        {
+          ret = _context.args.getOrExtract(val);
+        }
+        if (!isExact(ret))
+        {
+          return false;
+        }
+        _constants[variable(val)] = ret;
+        return _done[val] = true;
+      }
+
+    private:
+      llvm::DominatorTree _dominators;
+      AnalysisContext &_context;
+      FactMap &_constants;
+      std::unordered_map<const llvm::Value *, bool> _done;
+
+      IntervalDomain resolvePhi(const llvm::PHINode *phi)
+      {
+        // Exact only if every incoming value is the same constant.
+        IntervalDomain ret = IntervalDomain::UNINIT();
+        for (auto &incoming : phi->incoming_values())
+        {
+          if (!resolve(incoming))
+          {
+            return IntervalDomain::UNINIT();
+          }
+          auto val = _constants.getOrExtract(incoming);
+          if (!ret.isUnknown() && ret != val)
+          {
+            return IntervalDomain::UNINIT();
+          }
+          ret = val;
+        }
+        return ret;
+      }
+
+      IntervalDomain resolveCall(const llvm::CallInst *call)
+      {
+        auto *summary = _context.summaries ? _context.summaries->find(call) : nullptr;
+        if (!summary || !call->getType()->isIntegerTy())
+        {
+          return IntervalDomain::UNINIT();
+        }
+        if (!_context.contexts)
+        {
+          return summary->ret;
+        }
+        // The context of the call, if every argument it depends on resolves.
+        for (auto &arg : call->args())
+        {
+          const llvm::Value *val = arg;
+          if (val->getType()->isPointerTy())
+          {
+            auto *size = _context.sizes.find(val);
+            val = size && size->isSymbolic() ? size->symbol : nullptr;
+          }
+          if (val && !resolve(val))
+          {
+            return summary->ret;
+          }
+        }
+        auto result = _context.contexts->lookup(call, _constants);
+        if (!result)
+        {
+          return summary->ret;
+        }
+        return result->summary.ret;
+      }
+
+      IntervalDomain resolveLoad(const llvm::LoadInst *load)
+      {
+        auto *alloca = llvm::dyn_cast<llvm::AllocaInst>(load->getPointerOperand());
+        if (!load->getType()->isIntegerTy() || !alloca || alloca->isArrayAllocation() ||
+            !alloca->getAllocatedType()->isIntegerTy())
+        {
+          return IntervalDomain::UNINIT();
+        }
+        IntervalDomain ret = IntervalDomain::UNINIT();
+        bool dominated = false;
+        for (auto *user : alloca->users())
+        {
+          if (llvm::isa<llvm::LoadInst>(user))
+          {
+            continue;
+          }
+          auto *store = llvm::dyn_cast<llvm::StoreInst>(user);
+          // Anything else may write through an alias.
+          if (!store || store->getPointerOperand() != alloca || !resolve(store->getValueOperand()))
+          {
+            return IntervalDomain::UNINIT();
+          }
+          auto val = _constants.getOrExtract(store->getValueOperand());
+          if (!ret.isUnknown() && ret != val)
+          {
+            return IntervalDomain::UNINIT();
+          }
+          ret = val;
+          dominated |= _dominators.dominates(store, load);
+        }
+        return dominated ? ret : IntervalDomain::UNINIT();
+      }
+    };
+
+    /**
+     * @brief The index check() looks at, or nullptr if check() ignores gep.
+     */
+    const llvm::Value *checkedIndex(const llvm::GetElementPtrInst *gep)
+    {
+      auto *index = (gep->getNumIndices() == 1 ? gep->idx_begin() : gep->idx_begin() + 1)->get();
+      if (gep->getNumIndices() > 2 && !llvm::isa<llvm::ConstantInt>(index))
+      {
+        return nullptr;
+      }
+      return index;
+    }
+  } // namespace
+
+  std::vector<const llvm::Instruction *> OOBChecker::resolveConstants(const llvm::Function &func,
+                                                                      AnalysisContext &context)
+  {
+    std::vector<const llvm::Instruction *> ret;
+    ConstantResolver resolver(func, context);
+    for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter)
+    {
+      auto *gep = llvm::dyn_cast<llvm::GetElementPtrInst>(&*iter);
+      if (!gep)
+      {
+        continue;
+      }
+      auto *index = checkedIndex(gep);
+      auto *size = context.sizes.find(gep->getPointerOperand());
+      if (!index || (resolver.resolve(index) &&
+                     (!size || !size->isSymbolic() || resolver.resolve(size->symbol))))
+      {
+        context.resolved.insert(gep);
+      }
+      else
+      {
+        ret.push_back(gep);
+      }
+    }
+    return ret;
+  }
+
+  void OOBChecker::computeSlice(const llvm::Function &func,
+                                const std::vector<const llvm::Instruction *> &accesses,
+                                AnalysisContext &context)
+  {
+    std::vector<const llvm::StoreInst *> stores;
+    std::vector<const llvm::CallInst *> calls;
+    for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter)
+    {
+      if (auto *store = llvm::dyn_cast<llvm::StoreInst>(&*iter))
+      {
+        stores.push_back(store);
+      }
+      else if (auto *call = llvm::dyn_cast<llvm::CallInst>(&*iter))
+      {
+        if (context.summaries && context.summaries->find(call))
+        {
+          calls.push_back(call);
+        }
+      }
+    }
+
+    std::vector<const llvm::Value *> worklist;
+    auto add = [&](const llvm::Value *val)
+    {
+      if ((llvm::isa<llvm::Instruction>(val) || llvm::isa<llvm::Argument>(val)) &&
+          context.slice.insert(val).second)
+      {
+        worklist.push_back(val);
+      }
+    };
+    for (auto *ins : accesses)
+    {
+      auto *gep = llvm::cast<llvm::GetElementPtrInst>(ins);
+      add(gep);
+      add(checkedIndex(gep));
+      if (auto *size = context.sizes.find(gep->getPointerOperand()))
+      {
+        if (size->isSymbolic())
+        {
+          add(size->symbol);
+        }
+      }
+    }
+
+    while (!worklist.empty())
+    {
+      auto *val = worklist.back();
+      worklist.pop_back();
+      if (auto *load = llvm::dyn_cast<llvm::LoadInst>(val))
+      {
+        // Whatever may have been stored to the memory the load reads.
+        auto *pointer = load->getPointerOperand();
+        add(pointer);
+        for (auto *store : stores)
+        {
+          if (store->getPointerOperand() == pointer ||
+              context.pa.alias(store->getPointerOperand(), pointer))
+          {
+            add(store);
+            add(store->getPointerOperand());
+            add(store->getValueOperand());
+          }
+        }
+        for (auto *call : calls)
+        {
+          IntervalDomain written;
+          if (context.summaries->written(call, pointer, true, context.pa, written))
+          {
+            add(call);
+            for (auto &arg : call->args())
+            {
+              add(arg);
+            }
+          }
+        }
+      }
+      else if (llvm::isa<llvm::CastInst>(val) || llvm::isa<llvm::BinaryOperator>(val) ||
+               llvm::isa<llvm::PHINode>(val) || llvm::isa<llvm::CmpInst>(val) ||
+               llvm::isa<llvm::GetElementPtrInst>(val))
+      {
+        for (auto &op : llvm::cast<llvm::User>(val)->operands())
+        {
+          add(op);
+        }
+      }
+      else if (auto *call = llvm::dyn_cast<llvm::CallInst>(val))
+      {
+        // The context of the call depends on its arguments.
+        if (context.contexts)
+        {
+          for (auto &arg : call->args())
+          {
+            add(arg);
+          }
+        }
+      }
+    }
+  }
+
+  void OOBChecker::analyzeTiered(const llvm::Function &func, AnalysisContext &context)
+  {
+    // Whatever tier 0 leaves open is asked on demand, which only fails for
+    // values carried around a loop.
+    std::vector<const llvm::Instruction *> accesses;
+    RangeQuery query(func, context);
+    for (auto *ins : resolveConstants(func, context))
+    {
+      auto *gep = llvm::cast<llvm::GetElementPtrInst>(ins);
+      auto *index = checkedIndex(gep);
+      auto *size = context.sizes.find(gep->getPointerOperand());
+      auto *symbol = size && size->isSymbolic() ? size->symbol : nullptr;
+      IntervalDomain indexRange, symbolRange;
+      if (query.tryQuery(index, gep, indexRange) &&
+          (!symbol || query.tryQuery(symbol, gep, symbolRange)))
+      {
+        context.constants[variable(index)] = indexRange;
+        if (symbol)
+        {
+          context.constants[variable(symbol)] = symbolRange;
+        }
+        context.resolved.insert(gep);
+      }
+      else
+      {
+        accesses.push_back(gep);
+      }
+    }
+    if (accesses.empty())
+    {
+      return;
+    }
+    computeSlice(func, accesses, context);
+    analyze(func, context);
+  }
+} // namespace dataflow
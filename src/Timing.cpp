@@ -0,0 +1,62 @@
+#include "Timing.h"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Pass.h>
+#include <array>
+#include <mutex>
+
+namespace dataflow {
+
+namespace {
+
+const char *const PhaseNames[] = {"Points-to analysis", "Object sizes", "Summaries",
+                                  "Fixpoint",           "Checking",     "Printing"};
+
+/// llvm::Timer cannot be running in several threads at once, so the phases
+/// add up their own records and are only turned into a TimerGroup to print.
+std::mutex Mutex;
+std::array<llvm::TimeRecord, (size_t)Phase::Count> Records;
+std::array<bool, (size_t)Phase::Count> Seen;
+
+} // namespace
+
+PhaseTimer::PhaseTimer(Phase phase) : _phase(phase), _enabled(llvm::TimePassesIsEnabled) {
+  if (_enabled) {
+    _start = llvm::TimeRecord::getCurrentTime(true);
+  }
+}
+
+PhaseTimer::~PhaseTimer() {
+  if (!_enabled) {
+    return;
+  }
+  auto elapsed = llvm::TimeRecord::getCurrentTime(false);
+  elapsed -= _start;
+  std::lock_guard<std::mutex> lock(Mutex);
+  Records[(size_t)_phase] += elapsed;
+  Seen[(size_t)_phase] = true;
+}
+
+void printPhaseTimes(llvm::raw_ostream &os) {
+  if (!llvm::TimePassesIsEnabled) {
+    return;
+  }
+  llvm::StringMap<llvm::TimeRecord> records;
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    for (size_t i = 0; i < Records.size(); ++i) {
+      if (Seen[i]) {
+        records[PhaseNames[i]] = Records[i];
+      }
+      Records[i] = llvm::TimeRecord();
+      Seen[i] = false;
+    }
+  }
+  if (records.empty()) {
+    return;
+  }
+  llvm::TimerGroup group("oob-checker", "OOB Checker", records);
+  group.print(os);
+}
+
+} // namespace dataflow
@@ -0,0 +1,434 @@
+#include "Trace.h"
+#include "Utils.h"
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/Support/Compression.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/LEB128.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <cstring>
+#include <unistd.h>
+
+namespace dataflow {
+
+llvm::cl::opt<std::string> TraceFile(
+    "oob-trace",
+    llvm::cl::desc("Record every visit of the interval analysis to this binary file (see oobtrace)"),
+    llvm::cl::value_desc("filename"));
+
+llvm::cl::opt<bool> TraceCompress(
+    "oob-trace-compress",
+    llvm::cl::desc("Compress the chunks of -oob-trace with zlib"),
+    llvm::cl::init(false));
+
+namespace {
+
+const char MAGIC[8] = {'O', 'O', 'B', 'T', 'R', 'A', 'C', 'E'};
+const uint32_t VERSION = 1;
+/// Raw size at which a recorder writes out a chunk.
+const size_t CHUNK_SIZE = 1 << 20;
+
+// Layout of the file, in native byte order:
+//   FileHeader, then ChunkHeader and storedSize bytes for each chunk.
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+
+struct ChunkHeader {
+  uint64_t function;
+  uint32_t rawSize;
+  /// Compressed if different from rawSize.
+  uint32_t storedSize;
+};
+
+static_assert(sizeof(FileHeader) == 16, "unexpected padding in FileHeader");
+static_assert(sizeof(ChunkHeader) == 16, "unexpected padding in ChunkHeader");
+
+void writeString(llvm::raw_ostream &os, llvm::StringRef str) {
+  llvm::encodeULEB128(str.size(), os);
+  os << str;
+}
+
+/**
+ * @brief Reads the events of a chunk.
+ */
+struct Cursor {
+  const uint8_t *pos, *end;
+  bool failed = false;
+
+  uint64_t number() {
+    const char *error = nullptr;
+    unsigned size = 0;
+    auto ret = llvm::decodeULEB128(pos, &size, end, &error);
+    failed |= error != nullptr;
+    pos += size;
+    return ret;
+  }
+
+  int64_t signedNumber() {
+    const char *error = nullptr;
+    unsigned size = 0;
+    auto ret = llvm::decodeSLEB128(pos, &size, end, &error);
+    failed |= error != nullptr;
+    pos += size;
+    return ret;
+  }
+
+  std::string string() {
+    auto size = number();
+    if (failed || (uint64_t)(end - pos) < size) {
+      failed = true;
+      return "";
+    }
+    std::string ret((const char *)pos, size);
+    pos += size;
+    return ret;
+  }
+
+  uint8_t byte() {
+    if (pos == end) {
+      failed = true;
+      return 0;
+    }
+    return *pos++;
+  }
+};
+
+} // namespace
+
+TraceWriter::TraceWriter(std::unique_ptr<llvm::raw_fd_ostream> os) : _os(std::move(os)) {
+  // One write per chunk, so that forked workers writing to the same file do
+  // not interleave their chunks.
+  _os->SetUnbuffered();
+  FileHeader header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.reserved = 0;
+  _os->write((const char *)&header, sizeof(header));
+}
+
+TraceWriter *TraceWriter::instance() {
+  static std::unique_ptr<TraceWriter> writer = []() -> std::unique_ptr<TraceWriter> {
+    if (TraceFile.empty()) {
+      return nullptr;
+    }
+    std::error_code error;
+    auto os = std::make_unique<llvm::raw_fd_ostream>(TraceFile, error);
+    if (error) {
+      llvm::errs() << "Cannot write the trace " << TraceFile << ": " << error.message() << "\n";
+      return nullptr;
+    }
+    if (TraceCompress && !llvm::zlib::isAvailable()) {
+      llvm::errs() << "Built without zlib, the trace is not compressed\n";
+    }
+    return std::unique_ptr<TraceWriter>(new TraceWriter(std::move(os)));
+  }();
+  return writer.get();
+}
+
+uint64_t TraceWriter::newFunction() {
+  return (uint64_t)getpid() << 32 | _functions++;
+}
+
+void TraceWriter::write(uint64_t function, llvm::StringRef raw) {
+  llvm::StringRef stored = raw;
+  llvm::SmallVector<char, 0> compressed;
+  if (TraceCompress && llvm::zlib::isAvailable()) {
+    if (auto error = llvm::zlib::compress(raw, compressed)) {
+      llvm::consumeError(std::move(error));
+    } else if (compressed.size() < raw.size()) {
+      stored = llvm::StringRef(compressed.data(), compressed.size());
+    }
+  }
+  ChunkHeader header{function, (uint32_t)raw.size(), (uint32_t)stored.size()};
+  std::string chunk((const char *)&header, sizeof(header));
+  chunk += stored;
+  std::lock_guard<std::mutex> lock(_mutex);
+  _os->write(chunk.data(), chunk.size());
+}
+
+TraceRecorder::TraceRecorder(TraceWriter &writer, const llvm::Function &func)
+    : _writer(writer), _function(writer.newFunction()), _stream(_buffer) {
+  _stream << (char)TraceWriter::Function;
+  writeString(_stream, func.getName());
+  llvm::encodeULEB128(func.getInstructionCount(), _stream);
+  for (auto iter = llvm::inst_begin(func), end = llvm::inst_end(func); iter != end; ++iter) {
+    _ids.emplace(&*iter, _ids.size());
+    writeString(_stream, variable(&*iter));
+  }
+  _in.resize(_ids.size());
+  _out.resize(_ids.size());
+}
+
+TraceRecorder::~TraceRecorder() {
+  // Without the end event, the reader knows the trace is incomplete.
+  if (!_finished) {
+    flush();
+  }
+}
+
+uint32_t TraceRecorder::slot(const std::string &key) {
+  auto iter = _slots.find(key);
+  if (iter != _slots.end()) {
+    return iter->second;
+  }
+  uint32_t ret = _slots.size();
+  iter = _slots.emplace(key, ret).first;
+  _slotNames.push_back(&iter->first);
+  _stream << (char)TraceWriter::Slot;
+  writeString(_stream, key);
+  return ret;
+}
+
+uint32_t TraceRecorder::domain(const IntervalDomain &val) {
+  _encoded.clear();
+  llvm::raw_string_ostream os(_encoded);
+  if (val.isUnknown()) {
+    os << (char)0;
+  } else {
+    os << (char)1;
+    llvm::encodeULEB128(val.size(), os);
+    for (auto &interval : val) {
+      llvm::encodeSLEB128(interval.lower(), os);
+      llvm::encodeSLEB128(interval.upper(), os);
+    }
+  }
+  os.flush();
+  auto iter = _domains.find(_encoded);
+  if (iter != _domains.end()) {
+    return iter->second;
+  }
+  uint32_t ret = _domains.size() + 1;
+  _domains.emplace(_encoded, ret);
+  _stream << (char)TraceWriter::Domain << _encoded;
+  return ret;
+}
+
+void TraceRecorder::diff(Snapshot &last, const FactMap &facts, Changes &changes) {
+  changes.clear();
+  for (auto &fact : facts) {
+    auto key = slot(fact.first);
+    auto handle = domain(fact.second);
+    auto iter = last.find(key);
+    if (iter == last.end()) {
+      last.emplace(key, handle);
+      changes.emplace_back(key, handle);
+    } else if (iter->second != handle) {
+      iter->second = handle;
+      changes.emplace_back(key, handle);
+    }
+  }
+  if (last.size() == facts.size()) {
+    return;
+  }
+  for (auto iter = last.begin(); iter != last.end();) {
+    if (facts.contains(*_slotNames[iter->first])) {
+      ++iter;
+    } else {
+      changes.emplace_back(iter->first, 0);
+      iter = last.erase(iter);
+    }
+  }
+}
+
+void TraceRecorder::writeChanges(const Changes &changes) {
+  llvm::encodeULEB128(changes.size(), _stream);
+  for (auto &change : changes) {
+    llvm::encodeULEB128(change.first, _stream);
+    llvm::encodeULEB128(change.second, _stream);
+  }
+}
+
+void TraceRecorder::visit(const llvm::Instruction *ins, const FactMap &in, const FactMap &out) {
+  auto id = _ids.at(ins);
+  // New slots and domains go out before the visit that refers to them.
+  diff(_in[id], in, _inChanges);
+  diff(_out[id], out, _outChanges);
+  _stream << (char)TraceWriter::Visit;
+  llvm::encodeULEB128(id, _stream);
+  writeChanges(_inChanges);
+  writeChanges(_outChanges);
+  ++_visits;
+  _stream.flush();
+  if (_buffer.size() >= CHUNK_SIZE) {
+    flush();
+  }
+}
+
+void TraceRecorder::finish(bool degraded) {
+  _stream << (char)TraceWriter::End << (char)degraded;
+  llvm::encodeULEB128(_visits, _stream);
+  flush();
+  _finished = true;
+}
+
+void TraceRecorder::flush() {
+  _stream.flush();
+  if (!_buffer.empty()) {
+    _writer.write(_function, _buffer);
+    _buffer.clear();
+  }
+}
+
+void TraceFunction::replay(uint64_t count, std::vector<FactMap> &in,
+                           std::vector<FactMap> &out) const {
+  in.assign(instructions.size(), FactMap());
+  out.assign(instructions.size(), FactMap());
+  auto apply = [this](FactMap &facts, const std::vector<std::pair<uint32_t, uint32_t>> &changes) {
+    for (auto &change : changes) {
+      if (change.second) {
+        facts[slots[change.first]] = domains[change.second - 1];
+      } else {
+        facts.erase(slots[change.first]);
+      }
+    }
+  };
+  for (uint64_t i = 0; i < count && i < visits.size(); ++i) {
+    auto &visit = visits[i];
+    apply(in[visit.ins], visit.in);
+    apply(out[visit.ins], visit.out);
+  }
+  // The widening itself is not recorded; it applies to every fact.
+  if (degraded && count >= visitCount) {
+    for (auto *facts : {&in, &out}) {
+      for (auto &map : *facts) {
+        for (auto &fact : map) {
+          fact.second = IntervalDomain::UNINIT();
+        }
+      }
+    }
+  }
+}
+
+bool readTrace(const std::string &path, std::vector<TraceFunction> &functions,
+               const std::string *keep, std::string &error) {
+  auto buffer = llvm::MemoryBuffer::getFile(path, -1, false);
+  if (!buffer) {
+    error = buffer.getError().message();
+    return false;
+  }
+  auto data = (*buffer)->getBuffer();
+  FileHeader header;
+  if (data.size() < sizeof(header)) {
+    error = "not a trace";
+    return false;
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    error = "not a trace";
+    return false;
+  }
+  if (header.version != VERSION) {
+    error = "unsupported trace version " + std::to_string(header.version);
+    return false;
+  }
+
+  std::unordered_map<uint64_t, size_t> index;
+  llvm::SmallVector<char, 0> uncompressed;
+  for (size_t pos = sizeof(header); pos < data.size();) {
+    ChunkHeader chunk;
+    if (data.size() - pos < sizeof(chunk)) {
+      error = "truncated chunk header";
+      return false;
+    }
+    std::memcpy(&chunk, data.data() + pos, sizeof(chunk));
+    pos += sizeof(chunk);
+    if (data.size() - pos < chunk.storedSize) {
+      error = "truncated chunk";
+      return false;
+    }
+    auto raw = data.substr(pos, chunk.storedSize);
+    pos += chunk.storedSize;
+    if (chunk.storedSize != chunk.rawSize) {
+      if (!llvm::zlib::isAvailable()) {
+        error = "compressed trace, but built without zlib";
+        return false;
+      }
+      if (auto failure = llvm::zlib::uncompress(raw, uncompressed, chunk.rawSize)) {
+        error = llvm::toString(std::move(failure));
+        return false;
+      }
+      raw = llvm::StringRef(uncompressed.data(), uncompressed.size());
+    }
+
+    auto inserted = index.emplace(chunk.function, functions.size());
+    if (inserted.second) {
+      functions.emplace_back();
+    }
+    auto &func = functions[inserted.first->second];
+    bool kept = keep && (keep->empty() || *keep == func.name);
+    Cursor cursor{(const uint8_t *)raw.begin(), (const uint8_t *)raw.end()};
+    auto changes = [&cursor, &func](std::vector<std::pair<uint32_t, uint32_t>> &ret) {
+      auto count = cursor.number();
+      for (uint64_t i = 0; i < count && !cursor.failed; ++i) {
+        uint32_t slot = cursor.number();
+        uint32_t handle = cursor.number();
+        if (slot >= func.slots.size() || handle > func.domains.size()) {
+          cursor.failed = true;
+        }
+        ret.emplace_back(slot, handle);
+      }
+    };
+    while (cursor.pos != cursor.end && !cursor.failed) {
+      switch (cursor.byte()) {
+      case TraceWriter::Function: {
+        func.name = cursor.string();
+        auto count = cursor.number();
+        for (uint64_t i = 0; i < count && !cursor.failed; ++i) {
+          func.instructions.push_back(cursor.string());
+        }
+        kept = keep && (keep->empty() || *keep == func.name);
+        break;
+      }
+      case TraceWriter::Slot:
+        func.slots.push_back(cursor.string());
+        break;
+      case TraceWriter::Domain: {
+        auto val = IntervalDomain::UNINIT();
+        if (cursor.byte()) {
+          val = IntervalDomain::EMPTY();
+          auto count = cursor.number();
+          for (uint64_t i = 0; i < count && !cursor.failed; ++i) {
+            int lo = cursor.signedNumber();
+            int hi = cursor.signedNumber();
+            val.insert(Interval(lo, hi));
+          }
+        }
+        func.domains.push_back(val);
+        break;
+      }
+      case TraceWriter::Visit: {
+        TraceFunction::Visit visit;
+        visit.ins = cursor.number();
+        changes(visit.in);
+        changes(visit.out);
+        if (visit.ins >= func.instructions.size()) {
+          cursor.failed = true;
+        }
+        func.visitCount += 1;
+        if (kept) {
+          func.visits.push_back(std::move(visit));
+        }
+        break;
+      }
+      case TraceWriter::End:
+        func.degraded = cursor.byte();
+        cursor.number();
+        func.finished = true;
+        break;
+      default:
+        cursor.failed = true;
+      }
+    }
+    if (cursor.failed) {
+      error = "malformed events in the trace of " + func.name;
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace dataflow
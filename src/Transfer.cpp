@@ -1,4 +1,6 @@
-#include "OOBCheckerPass.h"
+#include "ContextCache.h"
+#include "FunctionSummary.h"
+#include "OOBChecker.h"
 #include "Utils.h"
 
 namespace dataflow
@@ -141,7 +143,7 @@ namespace dataflow
     }
   }
 
-  FactMap OOBCheckerPass::genSet(const llvm::Instruction *ins, AnalysisContext &context)
+  FactMap OOBChecker::genSet(const llvm::Instruction *ins, const AnalysisContext &context)
   {
     FactMap ret;
     const auto &inFacts = context.in.at(ins);
@@ -159,9 +161,6 @@ namespace dataflow
     }
     else if (auto cast = llvm::dyn_cast<llvm::CastInst>(ins))
     {
-      llvm::Value *sourceOperand = cast->getOperand(0);
-      uint64_t arraySize = context.arraySizeMap[sourceOperand];
-      context.arraySizeMap[cast] = arraySize;
       ret[variable(cast)] = eval(cast, inFacts);
     }
     else if (auto cmp = llvm::dyn_cast<llvm::CmpInst>(ins))
@@ -170,31 +169,14 @@ namespace dataflow
     }
     else if (auto alloca = llvm::dyn_cast<llvm::AllocaInst>(ins))
     {
-      llvm::Type *allocatedType = alloca->getAllocatedType();
-      if (allocatedType->isArrayTy())
-      {
-        llvm::ArrayType *arrayType = llvm::dyn_cast<llvm::ArrayType>(allocatedType);
-        uint64_t arraySize = arrayType->getNumElements();
-        context.arraySizeMap[alloca] = arraySize;
-      }
-      else if (allocatedType->isIntegerTy())
+      if (alloca->getAllocatedType()->isIntegerTy())
       {
         ret[variable(alloca)] = IntervalDomain::INF_DOMAIN();
       }
     }
-    else if (auto GEPInst = llvm::dyn_cast<llvm::GetElementPtrInst>(ins))
+    else if (llvm::isa<llvm::GetElementPtrInst>(ins))
     {
-      llvm::Value *arrayBase = GEPInst->getOperand(0);
-      uint64_t arraySize = context.arraySizeMap[arrayBase];
-      if (llvm::ConstantInt *CI = llvm::dyn_cast<llvm::ConstantInt>(GEPInst->getOperand(1)))
-      {
-        int64_t offset = CI->getSExtValue();
-        context.arraySizeMap[GEPInst] = arraySize - offset;
-      }
-      else
-      {
-        context.arraySizeMap[GEPInst] = arraySize;
-      }
+      // Array sizes are precomputed by ObjectSizeAnalysis.
     }
     else if (auto store = llvm::dyn_cast<llvm::StoreInst>(ins))
     {
@@ -202,11 +184,6 @@ namespace dataflow
       const auto toStore = store->getPointerOperand();
       const auto val = store->getValueOperand();
 
-      if (val->getType()->isPointerTy())
-      {
-        int arraySize = context.arraySizeMap[val];
-        context.arraySizeMap[toStore] = arraySize;
-      }
       if (val->getType()->isPointerTy())
         return ret;
       const auto valDomain = inFacts.getOrExtract(val);
@@ -214,7 +191,7 @@ namespace dataflow
       for (auto ptr : context.pointerSet)
       {
         std::string ptrStr = variable(ptr);
-        if (context.pa.alias(toStoreStr, ptrStr))
+        if (context.pa.alias(toStore, ptr))
         {
           if (inFacts.contains(ptrStr))
           {
@@ -235,41 +212,64 @@ namespace dataflow
       {
         ret[variable(load)] = inFacts.getOrExtract(pointer);
       }
-      if (pointer->getType()->isPointerTy())
-      {
-        llvm::Type *elementType = pointer->getType()->getPointerElementType();
-        if (elementType->isPointerTy())
-        {
-          if (context.arraySizeMap.find(pointer) != context.arraySizeMap.end())
-          {
-            int arraySize = context.arraySizeMap[pointer];
-            context.arraySizeMap[load] = arraySize;
-          }
-        }
-      }
     }
-    else if (auto branch = llvm::dyn_cast<llvm::BranchInst>(ins))
+    else if (llvm::isa<llvm::BranchInst>(ins))
     {
       // Analysis is flow-insensitive, so do nothing here.
     }
     else if (auto call = llvm::dyn_cast<llvm::CallInst>(ins))
     {
-      if (call->getCalledFunction() && call->getCalledFunction()->getName() == "malloc")
+      if (isAllocationCall(call))
       {
-        if (llvm::ConstantInt *CI = llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(0)))
-        {
-          uint64_t mallocSize = CI->getZExtValue();
-          context.arraySizeMap[call] = mallocSize / sizeof(int);
-        }
+        // Array sizes are precomputed by ObjectSizeAnalysis.
       }
-      else if (call->getType()->isIntegerTy())
+      else
       {
-        ret[variable(call)] = inFacts.getOrExtract(call);
+        auto summary = context.summaries ? context.summaries->find(call) : nullptr;
+        if (summary && context.contexts)
+        {
+          if (auto result = context.contexts->lookup(call, inFacts))
+          {
+            summary = &result->summary;
+          }
+        }
+        if (call->getType()->isIntegerTy())
+        {
+          ret[variable(call)] = summary ? summary->ret : inFacts.getOrExtract(call);
+        }
+        // The callee may store through its pointer arguments: a weak update
+        // of the memory they point to, like a store through an alias.
+        auto update = [&](const llvm::Value *ptr, bool aliases)
+        {
+          IntervalDomain written;
+          if (!summary->written(call, ptr, aliases, context.pa, written))
+          {
+            return;
+          }
+          std::string ptrStr = variable(ptr);
+          ret[ptrStr] = inFacts.contains(ptrStr) ? inFacts.getOrExtract(ptr) | written : written;
+        };
+        if (summary)
+        {
+          for (auto ptr : context.pointerSet)
+          {
+            update(ptr, true);
+          }
+          for (auto &arg : call->args())
+          {
+            // Arguments the fixpoint does not track, such as globals.
+            if (arg->getType()->isPointerTy() && !context.pointerSet.count(arg.get()))
+            {
+              update(arg.get(), false);
+            }
+          }
+        }
       }
     }
-    else if (auto retIns = llvm::dyn_cast<llvm::ReturnInst>(ins))
+    else if (llvm::isa<llvm::ReturnInst>(ins))
     {
-      // Analysis is intra-procedural, so do nothing here.
+      // The returned value reaches callers through the summary of the
+      // function (see SummaryTable::summarize), not through the facts here.
     }
     else
     {
@@ -279,7 +279,7 @@ namespace dataflow
     return ret;
   }
 
-  std::unordered_set<std::string> OOBCheckerPass::killSet(const llvm::Instruction *ins, AnalysisContext &context)
+  std::unordered_set<std::string> OOBChecker::killSet(const llvm::Instruction *ins, const AnalysisContext &context)
   {
     std::unordered_set<std::string> ret;
     const auto &inFacts = context.in.at(ins);
@@ -289,11 +289,6 @@ namespace dataflow
       // *pointer_op = value_op
       const auto toStore = store->getPointerOperand();
       const auto val = store->getValueOperand();
-      if (val->getType()->isPointerTy())
-      {
-        int arraySize = context.arraySizeMap[val];
-        context.arraySizeMap[toStore] = arraySize;
-      }
       if (val->getType()->isPointerTy())
         return ret;
       const auto valDomain = inFacts.getOrExtract(val);
@@ -301,7 +296,7 @@ namespace dataflow
       for (auto ptr : context.pointerSet)
       {
         std::string ptrStr = variable(ptr);
-        if (context.pa.alias(toStoreStr, ptrStr))
+        if (context.pa.alias(toStore, ptr))
         {
           ret.insert(ptrStr);
         }
@@ -1,26 +1,74 @@
 #include "Utils.h"
 #include "Domain.h"
-#include <sstream>
+#include <llvm/IR/Instructions.h>
+#include <algorithm>
 
 const char *WHITESPACES = " \t\n\r";
 const size_t VARIABLE_PADDED_LEN = 8;
 
 namespace dataflow {
 
+llvm::cl::opt<unsigned> Verbosity(
+    "oob-verbose",
+    llvm::cl::desc("What to print besides the errors: 1 for the points-to sets, 2 for the "
+                   "facts at every instruction as well"),
+    llvm::cl::init(0));
+
+llvm::cl::list<std::string> DumpFunctions(
+    "oob-dump-function",
+    llvm::cl::desc("Only print the facts of these functions (comma separated)"),
+    llvm::cl::CommaSeparated);
+
+bool dumpsFacts(const llvm::Function &func) {
+  if (Verbosity < 2) {
+    return false;
+  }
+  return DumpFunctions.empty() ||
+         std::find(DumpFunctions.begin(), DumpFunctions.end(), func.getName().str()) !=
+             DumpFunctions.end();
+}
+
+static thread_local NameScope *currentScope = nullptr;
+
+NameScope::NameScope(const llvm::Function &func)
+    : _slots(func.getParent(), false), _outer(currentScope) {
+  _slots.incorporateFunction(func);
+  currentScope = this;
+}
+
+NameScope::~NameScope() {
+  currentScope = _outer;
+}
+
 std::string variable(const llvm::Value *val) {
+  if (currentScope) {
+    auto iter = currentScope->_names.find(val);
+    if (iter != currentScope->_names.end()) {
+      return iter->second;
+    }
+  }
   std::string code;
   llvm::raw_string_ostream ss(code);
-  val->print(ss);
+  if (currentScope) {
+    val->print(ss, currentScope->_slots);
+  } else {
+    val->print(ss);
+  }
+  ss.flush();
   code.erase(0, code.find_first_not_of(WHITESPACES));
   auto ret = code.substr(0, code.find_first_of(WHITESPACES));
   if (ret == "ret" || ret == "br" || ret == "store") {
-    return code;
-  }
-  if (ret == "i1" || ret == "i8" || ret == "i32" || ret == "i64") {
     ret = code;
+  } else {
+    if (ret == "i1" || ret == "i8" || ret == "i32" || ret == "i64") {
+      ret = code;
+    }
+    for (auto i = ret.size(); i < VARIABLE_PADDED_LEN; i++) {
+      ret += " ";
+    }
   }
-  for (auto i = ret.size(); i < VARIABLE_PADDED_LEN; i++) {
-    ret += " ";
+  if (currentScope) {
+    currentScope->_names.emplace(val, ret);
   }
   return ret;
 }
@@ -34,6 +82,15 @@ std::string address(const llvm::Value *val) {
   return code;
 }
 
+bool isAllocationCall(const llvm::Value *val) {
+  if (auto call = llvm::dyn_cast<llvm::CallInst>(val)) {
+    if (auto func = call->getCalledFunction()) {
+      return func->getName() == "malloc" || func->getName() == "calloc";
+    }
+  }
+  return false;
+}
+
 void printMap(const llvm::Function &func, const InsFactMap &inMap, const InsFactMap &outMap) {
   llvm::outs() << "Dataflow Analysis Results:\n";
   for (auto iter = llvm::inst_begin(func), end = llvm::inst_end(func); iter != end; ++iter) {
@@ -47,37 +104,72 @@ void printMap(const llvm::Function &func, const InsFactMap &inMap, const InsFact
   }
 }
 
-void printInstructionTransfer(const llvm::Instruction *ins, const FactMap& inMap,
-                              const FactMap& outMap) {
-  // print 2 maps side by side
-  llvm::outs() << variable(ins) << "\n";
-  int inWidth = 5;
-  std::vector<std::string> lines(std::max(inMap.size(), outMap.size()));
-  int iLines = 0;
+FactWriter::FactWriter(llvm::raw_ostream &os, size_t capacity)
+    : _os(os), _capacity(capacity), _stream(_buffer) {
+  _buffer.reserve(capacity);
+}
+
+FactWriter::~FactWriter() {
+  flush();
+}
+
+void FactWriter::flush() {
+  _stream.flush();
+  _os << _buffer;
+  _buffer.clear();
+}
+
+void FactWriter::write(const llvm::Instruction *ins, const FactMap &inMap,
+                       const FactMap &outMap) {
+  write(variable(ins), inMap, outMap);
+}
+
+void FactWriter::write(llvm::StringRef name, const FactMap &inMap, const FactMap &outMap) {
+  // print 2 maps side by side; the In column is as wide as its longest fact
+  if (_domains.size() < inMap.size()) {
+    _domains.resize(inMap.size());
+  }
+  size_t inWidth = 5;
+  size_t i = 0;
   for (auto &fact : inMap) {
-    std::ostringstream oss;
-    oss << fact.first << " |-> " << fact.second;
-    auto line = oss.str();
-    inWidth = std::max(inWidth, (int)line.size());
-    lines[iLines++] = std::move(line);
+    auto &domain = _domains[i++];
+    domain.clear();
+    llvm::raw_string_ostream ss(domain);
+    static_cast<llvm::raw_ostream &>(ss) << fact.second;
+    ss.flush();
+    inWidth = std::max(inWidth, fact.first.size() + 5 + domain.size());
   }
 
-  iLines = 0;
-  for (auto &fact : outMap) {
-    std::ostringstream oss;
-    oss << " | " << fact.first << " |-> " << fact.second;
-    auto line = oss.str();
-    lines[iLines].resize(inWidth, ' ');
-    lines[iLines].insert(lines[iLines].end(), line.begin(), line.end());
-    ++iLines;
+  llvm::raw_ostream &os = _stream;
+  os << name << "\n";
+  os << "IN";
+  os.indent(inWidth - 2) << " | OUT\n";
+  auto in = inMap.begin();
+  auto out = outMap.begin();
+  for (i = 0; in != inMap.end() || out != outMap.end(); ++i) {
+    size_t width = 0;
+    if (in != inMap.end()) {
+      os << in->first << " |-> " << _domains[i];
+      width = in->first.size() + 5 + _domains[i].size();
+      ++in;
+    }
+    if (out != outMap.end()) {
+      os.indent(inWidth - width) << " | " << out->first << " |-> " << out->second;
+      ++out;
+    }
+    os << "\n";
   }
-  std::string header = "IN";
-  header.resize(inWidth, ' ');
-  llvm::outs() << header << " | OUT\n";
-  for (auto &line : lines) {
-    llvm::outs() << line << "\n";
+  os << "\n";
+
+  _stream.flush();
+  if (_buffer.size() >= _capacity) {
+    flush();
   }
-  llvm::outs() << "\n";
 }
 
-} // namespace dataflow
\ No newline at end of file
+void printInstructionTransfer(const llvm::Instruction *ins, const FactMap& inMap,
+                              const FactMap& outMap, llvm::raw_ostream &os) {
+  FactWriter(os).write(ins, inMap, outMap);
+}
+
+} // namespace dataflow
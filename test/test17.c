@@ -0,0 +1,16 @@
+void set(int* buf) {
+  buf[4] = 0; // ok
+}
+
+void clear(int* buf) {
+  buf[5] = 0; // out-of-bounds
+}
+
+int main() {
+  int a[10];
+  int b[5];
+  set(a);
+  clear(a);
+  clear(b);
+  return 0;
+}
@@ -0,0 +1,14 @@
+#include <stdlib.h>
+
+void g(int c) {
+  int n = c ? 5 : 6;
+  int* arr = malloc(n * sizeof(int));
+  arr[4] = 0; // ok
+  arr[5] = 0; // out-of-bounds
+  int vla[n];
+  vla[4] = 0; // ok
+  vla[5] = 0; // out-of-bounds
+  int* zeroed = calloc(n, sizeof(int));
+  zeroed[4] = 0; // ok
+  zeroed[n] = 0; // out-of-bounds
+}
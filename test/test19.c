@@ -0,0 +1,14 @@
+// Checked by `make lazy` too: oobcheck must report the same errors with
+// -lazy and -lazy=false. With -oob-contexts, get() is checked again for each
+// call in main(), after its own report, so its body must still be there.
+int get(int* buf, int i) {
+  return buf[i];
+}
+
+int main() {
+  int a[10];
+  int b[4];
+  int k = 5;
+  a[k] = 0;
+  return get(a, k) + get(b, k); // out-of-bounds in get() via the second call
+}
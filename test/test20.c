@@ -0,0 +1,14 @@
+// Checked by `make cache` too: built once with LIMIT 5 and once with LIMIT
+// 12, and checked with the same -oob-cache, the second run must not reuse
+// the clean report of the first.
+#ifndef LIMIT
+#define LIMIT 5
+#endif
+
+int n = LIMIT;
+
+int main() {
+  int a[10];
+  a[n] = 0; // out-of-bounds once n is 12
+  return 0;
+}
@@ -0,0 +1,230 @@
+#include "CompileCommands.h"
+
+#include <llvm/Support/raw_ostream.h>
+
+#ifdef OOBCHECK_WITH_CLANG
+
+#include <clang/CodeGen/CodeGenAction.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/TextDiagnosticPrinter.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <clang/Tooling/JSONCompilationDatabase.h>
+#include <clang/Tooling/Tooling.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace dataflow {
+
+namespace {
+
+/**
+ * @brief A translation unit compiled to IR, on its way to the checker.
+ */
+struct CompiledUnit {
+  size_t index = 0;
+  std::unique_ptr<llvm::LLVMContext> context;
+  std::unique_ptr<llvm::Module> module;
+};
+
+/**
+ * @brief Queue between the compiling and the checking threads. push() blocks
+ * while the queue is full, so compiling cannot run arbitrarily far ahead.
+ */
+class UnitQueue {
+public:
+  explicit UnitQueue(size_t capacity) : _capacity(capacity) {}
+
+  void push(CompiledUnit unit) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _notFull.wait(lock, [this] { return _units.size() < _capacity; });
+    _units.push_back(std::move(unit));
+    _notEmpty.notify_one();
+  }
+
+  /**
+   * @return false once the queue is empty and no more units will come.
+   */
+  bool pop(CompiledUnit &unit) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _notEmpty.wait(lock, [this] { return !_units.empty() || _closed; });
+    if (_units.empty()) {
+      return false;
+    }
+    unit = std::move(_units.front());
+    _units.pop_front();
+    _notFull.notify_one();
+    return true;
+  }
+
+  /// No more units will be pushed.
+  void close() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+    _notEmpty.notify_all();
+  }
+
+private:
+  size_t _capacity;
+  std::deque<CompiledUnit> _units;
+  bool _closed = false;
+  std::mutex _mutex;
+  std::condition_variable _notFull, _notEmpty;
+};
+
+/**
+ * @brief Runs the front end on one invocation and keeps the generated module.
+ */
+class EmitModuleAction : public clang::tooling::ToolAction {
+public:
+  explicit EmitModuleAction(llvm::LLVMContext &context) : _context(context) {}
+
+  bool runInvocation(std::shared_ptr<clang::CompilerInvocation> invocation,
+                     clang::FileManager *files,
+                     std::shared_ptr<clang::PCHContainerOperations> pchOperations,
+                     clang::DiagnosticConsumer *diagnostics) override {
+    clang::CompilerInstance compiler(std::move(pchOperations));
+    compiler.setInvocation(std::move(invocation));
+    compiler.setFileManager(files);
+    compiler.createDiagnostics(diagnostics, false);
+    if (!compiler.hasDiagnostics()) {
+      return false;
+    }
+    compiler.createSourceManager(*files);
+    clang::EmitLLVMOnlyAction action(&_context);
+    bool success = compiler.ExecuteAction(action);
+    module = action.takeModule();
+    files->clearStatCache();
+    return success && module;
+  }
+
+  std::unique_ptr<llvm::Module> module;
+
+private:
+  llvm::LLVMContext &_context;
+};
+
+/**
+ * @brief Compiles one command to IR; diagnostics go to file.err.
+ */
+CompiledUnit compile(const clang::tooling::CompileCommand &command,
+                     const clang::tooling::ArgumentsAdjuster &adjuster, size_t index,
+                     FileReport &file) {
+  CompiledUnit unit{index, std::make_unique<llvm::LLVMContext>(), nullptr};
+  llvm::raw_string_ostream err(file.err);
+
+  // Each unit resolves relative paths against its own directory, without
+  // touching the working directory of the process.
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSystem(
+      llvm::vfs::createPhysicalFileSystem().release());
+  if (fileSystem->setCurrentWorkingDirectory(command.Directory)) {
+    err << "oobcheck: cannot enter " << command.Directory << "\n";
+    return unit;
+  }
+  llvm::IntrusiveRefCntPtr<clang::FileManager> files(
+      new clang::FileManager(clang::FileSystemOptions(), fileSystem));
+  llvm::IntrusiveRefCntPtr<clang::DiagnosticOptions> diagnosticOptions(new clang::DiagnosticOptions());
+  clang::TextDiagnosticPrinter diagnostics(err, diagnosticOptions.get());
+
+  EmitModuleAction action(*unit.context);
+  clang::tooling::ToolInvocation invocation(adjuster(command.CommandLine, command.Filename),
+                                            &action, files.get());
+  invocation.setDiagnosticConsumer(&diagnostics);
+  if (invocation.run()) {
+    unit.module = std::move(action.module);
+  }
+  return unit;
+}
+
+} // namespace
+
+bool scanCompileCommands(const std::string &path, unsigned jobs, const std::string &resourceDir,
+                         std::vector<FileReport> &files) {
+  std::string error;
+  auto database = clang::tooling::JSONCompilationDatabase::loadFromFile(
+      path, error, clang::tooling::JSONCommandLineSyntax::AutoDetect);
+  if (!database) {
+    llvm::errs() << "oobcheck: " << error << "\n";
+    return false;
+  }
+  auto commands = database->getAllCompileCommands();
+  files.resize(commands.size());
+  for (size_t i = 0; i < commands.size(); ++i) {
+    files[i].path = commands[i].Filename;
+  }
+
+  // Only build the IR: no output files, no dependency files, and keep the
+  // value names the checker reports.
+  using namespace clang::tooling;
+  auto adjuster = combineAdjusters(
+      combineAdjusters(getClangStripOutputAdjuster(), getClangStripDependencyFileAdjuster()),
+      getClangSyntaxOnlyAdjuster());
+  adjuster = combineAdjusters(
+      adjuster, getInsertArgumentAdjuster("-fno-discard-value-names", ArgumentInsertPosition::END));
+  if (!resourceDir.empty()) {
+    adjuster = combineAdjusters(
+        adjuster, getInsertArgumentAdjuster(CommandLineArguments{"-resource-dir=" + resourceDir},
+                                            ArgumentInsertPosition::END));
+  }
+
+  // Half of the threads compile, the other half check.
+  unsigned threads = jobs ? jobs : std::max(std::thread::hardware_concurrency(), 1u);
+  unsigned producers = std::max(threads / 2, 1u);
+  unsigned consumers = std::max(threads - producers, 1u);
+  UnitQueue queue(2 * consumers);
+  std::atomic<size_t> next(0);
+  std::atomic<unsigned> running(producers);
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < producers; ++i) {
+    workers.emplace_back([&] {
+      for (size_t index = next++; index < commands.size(); index = next++) {
+        auto unit = compile(commands[index], adjuster, index, files[index]);
+        if (unit.module) {
+          queue.push(std::move(unit));
+        }
+      }
+      if (--running == 0) {
+        queue.close();
+      }
+    });
+  }
+  for (unsigned i = 0; i < consumers; ++i) {
+    workers.emplace_back([&] {
+      CompiledUnit unit;
+      while (queue.pop(unit)) {
+        // The consumers already run in parallel.
+        checkModule(*unit.module, files[unit.index], 1);
+        // The module has to go before the context it lives in.
+        unit.module.reset();
+        unit.context.reset();
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  return true;
+}
+
+} // namespace dataflow
+
+#else
+
+namespace dataflow {
+
+bool scanCompileCommands(const std::string &, unsigned, const std::string &,
+                         std::vector<FileReport> &) {
+  llvm::errs() << "oobcheck: built without the clang libraries, -compile-commands is unavailable\n";
+  return false;
+}
+
+} // namespace dataflow
+
+#endif // OOBCHECK_WITH_CLANG
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "oobcheck.h"
+
+namespace dataflow {
+
+/**
+ * @brief Compiles every translation unit of a compile_commands.json to IR
+ * in memory and checks it.
+ *
+ * Translation units flow through a bounded queue from the compiling
+ * threads to the checking threads, so the front end and the analysis of
+ * different files overlap and only a few modules are in memory at once.
+ *
+ * @param path The compile_commands.json to read.
+ * @param jobs Number of worker threads, 0 for one per hardware thread.
+ * @param resourceDir Clang resource directory for the builtin headers, or
+ * empty to locate it from the compiler in each command.
+ * @param files Receives one report per translation unit, in database order.
+ * @return false if the database could not be loaded.
+ */
+bool scanCompileCommands(const std::string &path, unsigned jobs, const std::string &resourceDir,
+                         std::vector<FileReport> &files);
+
+} // namespace dataflow
@@ -0,0 +1,175 @@
+#include "LazyModule.h"
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/SourceMgr.h>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace dataflow {
+
+namespace {
+
+/**
+ * @brief Union-find over the names of functions and globals: two names end
+ * up in one component if a body connects them.
+ */
+class Components {
+public:
+  size_t id(llvm::StringRef name) {
+    auto inserted = _ids.emplace(name.str(), _parent.size());
+    if (inserted.second) {
+      _parent.push_back(_parent.size());
+    }
+    return inserted.first->second;
+  }
+
+  size_t find(size_t node) {
+    while (_parent[node] != node) {
+      node = _parent[node] = _parent[_parent[node]];
+    }
+    return node;
+  }
+
+  void join(size_t a, size_t b) { _parent[find(a)] = find(b); }
+
+private:
+  std::unordered_map<std::string, size_t> _ids;
+  std::vector<size_t> _parent;
+};
+
+/// The functions and globals the module defines, as opposed to declares.
+using Definitions = std::unordered_set<const llvm::GlobalObject *>;
+
+/**
+ * @brief Joins func with the defined functions and globals val refers to,
+ * looking through constant expressions. Declarations and intrinsics have no
+ * body to share, and would join every caller of printf or malloc.
+ */
+void connect(const llvm::Value *val, size_t func, const Definitions &defined,
+             Components &components) {
+  if (auto global = llvm::dyn_cast<llvm::GlobalObject>(val)) {
+    if (global->hasName() && defined.count(global)) {
+      components.join(func, components.id(global->getName()));
+    }
+  } else if (auto expr = llvm::dyn_cast<llvm::ConstantExpr>(val)) {
+    for (auto &op : expr->operands()) {
+      connect(op, func, defined, components);
+    }
+  }
+}
+
+/**
+ * @brief Records what the body of func refers to.
+ * @return true if func contains an array access.
+ */
+bool scan(const llvm::Function &func, const Definitions &defined, Components &components) {
+  bool access = false;
+  auto id = components.id(func.getName());
+  for (auto iter = inst_begin(func), end = inst_end(func); iter != end; ++iter) {
+    access |= llvm::isa<llvm::GetElementPtrInst>(*iter);
+    for (auto &op : iter->operands()) {
+      connect(op, id, defined, components);
+    }
+  }
+  return access;
+}
+
+bool materialize(llvm::Function &func, llvm::raw_ostream &err) {
+  if (auto error = func.materialize()) {
+    llvm::logAllUnhandledErrors(std::move(error), err, "oobcheck: ");
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+bool loadLazily(const std::string &path, LazyModule &loaded, llvm::raw_ostream &err) {
+  llvm::SMDiagnostic diagnostic;
+  auto context = std::make_unique<llvm::LLVMContext>();
+  auto module = llvm::getLazyIRFileModule(path, diagnostic, *context);
+  if (!module) {
+    diagnostic.print("oobcheck", err);
+    return false;
+  }
+
+  // Bodies are dropped as the scan goes, so note the definitions first.
+  Definitions defined;
+  for (auto &global : module->global_objects()) {
+    if (!global.isDeclaration()) {
+      defined.insert(&global);
+    }
+  }
+
+  // Pre-scan, holding at most one body at a time.
+  Components components;
+  std::unordered_set<size_t> candidateIds;
+  std::vector<size_t> candidates;
+  bool lazy = false;
+  size_t index = 0;
+  for (auto &func : *module) {
+    index += 1;
+    if (func.isDeclaration()) {
+      continue;
+    }
+    bool materializable = func.isMaterializable();
+    if (materializable && !materialize(func, err)) {
+      return false;
+    }
+    if (scan(func, defined, components)) {
+      candidates.push_back(index);
+      candidateIds.insert(components.id(func.getName()));
+    }
+    if (materializable) {
+      func.deleteBody();
+      lazy = true;
+    }
+  }
+  // Components only merge while scanning, so look up the final roots now.
+  std::unordered_set<size_t> roots;
+  for (auto id : candidateIds) {
+    roots.insert(components.find(id));
+  }
+
+  // The scanned module has lost its bodies; read bitcode again into a fresh
+  // context, so struct types keep their names.
+  if (lazy) {
+    module.reset();
+    context = std::make_unique<llvm::LLVMContext>();
+    module = llvm::getLazyIRFileModule(path, diagnostic, *context);
+    if (!module) {
+      diagnostic.print("oobcheck", err);
+      return false;
+    }
+  }
+  // Functions are in the same order in both reads.
+  index = 0;
+  auto candidate = candidates.begin();
+  for (auto &func : *module) {
+    index += 1;
+    if (func.isDeclaration()) {
+      continue;
+    }
+    if (candidate != candidates.end() && *candidate == index) {
+      loaded.candidates.push_back(&func);
+      ++candidate;
+    }
+    // Unnamed functions cannot be told apart by the scan, so keep them.
+    if (func.hasName() && !roots.count(components.find(components.id(func.getName())))) {
+      func.deleteBody();
+      continue;
+    }
+    if (func.isMaterializable() && !materialize(func, err)) {
+      return false;
+    }
+  }
+  loaded.context = std::move(context);
+  loaded.module = std::move(module);
+  return true;
+}
+
+} // namespace dataflow
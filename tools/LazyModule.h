@@ -0,0 +1,38 @@
+#pragma once
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/raw_ostream.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dataflow {
+
+/**
+ * @brief A module loaded by loadLazily(), together with its context.
+ */
+struct LazyModule {
+  std::unique_ptr<llvm::LLVMContext> context;
+  std::unique_ptr<llvm::Module> module;
+  /// The functions with an array access, in module order.
+  std::vector<llvm::Function *> candidates;
+};
+
+/**
+ * @brief Loads the .ll or .bc file at path, keeping only the function bodies
+ * the checker needs.
+ *
+ * A first pass reads the bodies of a bitcode file one at a time, notes which
+ * functions contain an array access and which functions and globals each
+ * body refers to, and drops the body again. Only functions that can reach a
+ * candidate through calls to defined functions or shared defined globals
+ * are then materialized, since the module-wide pointer and object size
+ * analyses read them; every other function stays unmaterialized. Text IR cannot be read lazily, so it is
+ * parsed once and the bodies that are not needed are deleted.
+ *
+ * @return false if the file cannot be read; the error is printed to err.
+ */
+bool loadLazily(const std::string &path, LazyModule &loaded, llvm::raw_ostream &err);
+
+} // namespace dataflow
@@ -0,0 +1,263 @@
+/**
+ * @file oobbench.cpp
+ * @brief Scaling benchmark: runs the checker on modules of growing size.
+ *
+ * Usage: oobbench [-sweep <parameter>] [-from X] [-to Y] [-factor F | -step S]
+ *                 [-csv] [generator options] [checker options]
+ *
+ * Generates a module with the options of oobgen for every value of one of
+ * them, from -from to -to, multiplied by -factor or increased by -step each
+ * time, and checks it like the pass does. Each point runs in a forked
+ * process of its own, so its peak RSS is its own. For every point, prints
+ * the time of the check (not of the generation), the instructions the
+ * fixpoint visited, the errors, the functions over budget, the peak RSS, and
+ * how fast time and visits grew since the previous point: the exponent k of
+ * size^k, about 1 while they grow linearly and 2 once they grow
+ * quadratically.
+ */
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/InitLLVM.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ContextCache.h"
+#include "FunctionSummary.h"
+#include "Generator.h"
+#include "OOBChecker.h"
+#include "Utils.h"
+
+using namespace dataflow;
+
+static llvm::cl::opt<std::string> Sweep(
+    "sweep",
+    llvm::cl::desc("The generator option to vary: instructions, blocks, loop-depth, arrays, "
+                   "locals, geps, alias-density or functions"),
+    llvm::cl::init("instructions"));
+
+static llvm::cl::opt<double> From("from", llvm::cl::desc("First value of the swept option"),
+                                  llvm::cl::init(100));
+
+static llvm::cl::opt<double> To("to", llvm::cl::desc("Last value of the swept option"),
+                                llvm::cl::init(3200));
+
+static llvm::cl::opt<double> Factor("factor",
+                                    llvm::cl::desc("Multiply the swept option by this each time"),
+                                    llvm::cl::init(2));
+
+static llvm::cl::opt<double> Step(
+    "step", llvm::cl::desc("Add this to the swept option each time instead of -factor"),
+    llvm::cl::init(0));
+
+static llvm::cl::opt<bool> Csv("csv", llvm::cl::desc("Print comma separated values"));
+
+namespace {
+
+/// What the process of one point sends back.
+struct Result {
+  double seconds;
+  uint64_t instructions;
+  uint64_t blocks;
+  uint64_t transfers;
+  uint64_t errors;
+  uint64_t degraded;
+};
+
+/**
+ * @brief Sets the option called name to value.
+ * @return false if there is no such option.
+ */
+bool set(GeneratorOptions &options, llvm::StringRef name, double value) {
+  auto count = (unsigned)std::lround(value);
+  if (name == "instructions") {
+    options.instructions = count;
+  } else if (name == "blocks") {
+    options.blocks = count;
+  } else if (name == "loop-depth") {
+    options.loopDepth = count;
+  } else if (name == "arrays") {
+    options.arrays = count;
+  } else if (name == "locals") {
+    options.locals = count;
+  } else if (name == "geps") {
+    options.geps = count;
+  } else if (name == "alias-density") {
+    options.aliasDensity = value;
+  } else if (name == "functions") {
+    options.functions = count;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Generates the module of options and checks it like
+ * OOBCheckerPass, without printing anything.
+ */
+Result measure(const GeneratorOptions &options) {
+  Result ret{};
+  llvm::LLVMContext context;
+  auto module = generateModule(context, options);
+  for (auto &func : *module) {
+    ret.blocks += func.size();
+    ret.instructions += func.getInstructionCount();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  PointerAnalysis pa(*module, DemandDrivenPA, llvm::nulls());
+  ObjectSizeAnalysis sizes(*module, pa);
+  auto summaries = SummaryTable::build(*module, pa, sizes);
+  auto contexts = ContextCache::build(pa, sizes, summaries.get());
+  OOBChecker checker;
+  checker.summaries = summaries.get();
+  checker.contexts = contexts.get();
+  for (auto &func : *module) {
+    NameScope names(func);
+    std::string errors;
+    llvm::raw_string_ostream err(errors);
+    if (!checker.reportWithoutDataflow(func, sizes, err)) {
+      AnalysisContext analysis{pa, sizes};
+      analysis.summaries = summaries.get();
+      analysis.contexts = contexts.get();
+      if (TieredAnalysis) {
+        checker.analyzeTiered(func, analysis);
+      } else {
+        checker.analyze(func, analysis);
+      }
+      checker.report(func, analysis, llvm::nulls(), err);
+      ret.transfers += analysis.transfers;
+      ret.degraded += analysis.degraded;
+    }
+    err.flush();
+    for (size_t pos = errors.find(OOBChecker::errorMessage); pos != std::string::npos;
+         pos = errors.find(OOBChecker::errorMessage, pos + 1)) {
+      ret.errors += 1;
+    }
+  }
+  ret.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return ret;
+}
+
+/**
+ * @brief Runs measure() in a child process.
+ * @param maxRss Set to the peak RSS of the child, in kilobytes.
+ * @return false if the child failed.
+ */
+bool measureInChild(const GeneratorOptions &options, Result &result, long &maxRss) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return false;
+  }
+  auto pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    auto measured = measure(options);
+    bool sent = write(fds[1], &measured, sizeof(measured)) == sizeof(measured);
+    _exit(sent ? 0 : 1);
+  }
+  close(fds[1]);
+  bool received = read(fds[0], &result, sizeof(result)) == sizeof(result);
+  close(fds[0]);
+  int status = 0;
+  struct rusage usage = {};
+  while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR) {
+  }
+  maxRss = usage.ru_maxrss;
+  return received && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/// The exponent k of y ~ x^k between two points, or NAN if unknown.
+double slope(double x0, double y0, double x1, double y1) {
+  if (x0 <= 0 || x1 <= x0 || y0 <= 0 || y1 <= 0) {
+    return NAN;
+  }
+  return std::log(y1 / y0) / std::log(x1 / x0);
+}
+
+void printSlope(llvm::raw_ostream &os, double value, int width) {
+  if (std::isnan(value)) {
+    os << llvm::format("%*s", width, Csv ? "" : "-");
+  } else {
+    os << llvm::format("%*.2f", width, value);
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM init(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv,
+                                    "Benchmarks the checker on generated modules of growing size\n");
+
+  auto options = generatorOptions();
+  if (!set(options, Sweep, From)) {
+    llvm::errs() << "oobbench: cannot sweep " << Sweep << "\n";
+    return 1;
+  }
+  if (Step <= 0 && Factor <= 1) {
+    llvm::errs() << "oobbench: -factor must be above 1, or -step above 0\n";
+    return 1;
+  }
+
+  auto &os = llvm::outs();
+  if (Csv) {
+    os << Sweep << ",instructions,blocks,seconds,transfers,errors,degraded,peak_rss_kb,"
+       << "time_slope,transfer_slope\n";
+  } else {
+    os << llvm::format("%14s", Sweep.c_str())
+       << " instructions   blocks    seconds    transfers   errors degraded   peak RSS    time ^k  "
+          "visits ^k\n";
+  }
+  double previousX = 0;
+  Result previous{};
+  bool failed = false;
+  for (double x = From; x <= To * (1 + 1e-9); x = Step > 0 ? x + Step : x * Factor) {
+    set(options, Sweep, x);
+    Result result;
+    long maxRss = 0;
+    if (!measureInChild(options, result, maxRss)) {
+      llvm::errs() << "oobbench: the check failed for " << Sweep << " = " << x << "\n";
+      failed = true;
+      continue;
+    }
+    auto timeSlope = slope(previousX, previous.seconds, x, result.seconds);
+    auto transferSlope = slope(previousX, previous.transfers, x, result.transfers);
+    if (Csv) {
+      os << llvm::format("%g", x) << "," << result.instructions << "," << result.blocks << ","
+         << llvm::format("%.6f", result.seconds) << "," << result.transfers << ","
+         << result.errors << "," << result.degraded << "," << maxRss << ",";
+      printSlope(os, timeSlope, 0);
+      os << ",";
+      printSlope(os, transferSlope, 0);
+    } else {
+      os << llvm::format("%14g %12llu %8llu %10.4f %12llu %8llu %8llu %7.1f MB ", x,
+                         (unsigned long long)result.instructions,
+                         (unsigned long long)result.blocks, result.seconds,
+                         (unsigned long long)result.transfers,
+                         (unsigned long long)result.errors,
+                         (unsigned long long)result.degraded, maxRss / 1024.0);
+      printSlope(os, timeSlope, 10);
+      os << " ";
+      printSlope(os, transferSlope, 10);
+    }
+    os << "\n";
+    os.flush();
+    previousX = x;
+    previous = result;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,303 @@
+/**
+ * @file oobcheck.cpp
+ * @brief Standalone driver: checks .ll and .bc files without going through opt.
+ *
+ * Usage: oobcheck [-j N] [-file-list <file>] <input files...>
+ *        oobcheck [-j N] -compile-commands <compile_commands.json>
+ *
+ * Every input is parsed in its own LLVMContext, so up to N files are loaded
+ * and analyzed at the same time. Unless -lazy=false, only the functions that
+ * contain an array access are checked (see LazyModule.h). With
+ * -compile-commands, the translation units of a project are compiled in
+ * memory instead (see CompileCommands.h). The reports are printed in the
+ * order the inputs were given: the facts of each file on stdout, and its errors on
+ * stderr with the file name in front of each line.
+ */
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/InitLLVM.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Config/llvm-config.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CompileCommands.h"
+#include "ContextCache.h"
+#include "Diagnostics.h"
+#include "FunctionSummary.h"
+#include "LazyModule.h"
+#include "OOBChecker.h"
+#include "ParallelDriver.h"
+#include "ResultCache.h"
+#include "Snapshot.h"
+#include "Timing.h"
+#include "oobcheck.h"
+
+using namespace dataflow;
+
+static llvm::cl::list<std::string> InputFiles(llvm::cl::Positional,
+                                              llvm::cl::desc("<input .ll/.bc files>"));
+
+static llvm::cl::opt<std::string> FileList(
+    "file-list", llvm::cl::desc("Also check the files listed in this file, one path per line"),
+    llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<std::string> CompileCommands(
+    "compile-commands",
+    llvm::cl::desc("Compile and check every translation unit of this compile_commands.json"),
+    llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<std::string> ResourceDir(
+    "resource-dir", llvm::cl::desc("Clang resource directory used with -compile-commands"),
+    llvm::cl::value_desc("directory"));
+
+static llvm::cl::alias JobsAlias("j", llvm::cl::desc("Alias for -oob-jobs"),
+                                 llvm::cl::aliasopt(Jobs));
+
+/// Shared by all inputs, set up by main() if -oob-cache is given.
+static std::unique_ptr<ResultCache> Cache;
+
+/// Shared by all inputs, set up by main() if -oob-diagnostics is given.
+static std::unique_ptr<DiagnosticStream> Diagnostics;
+
+/// Shared by all inputs, set up by main() if -oob-snapshot is given.
+static std::unique_ptr<SnapshotWriter> FactSnapshot;
+
+/// Triage counts of all inputs.
+static TriageCounts Triaged;
+
+static llvm::cl::opt<bool> Lazy(
+    "lazy",
+    llvm::cl::desc("Only load and check the functions that contain an array access, and the "
+                   "functions they depend on"),
+    llvm::cl::init(true));
+
+/**
+ * @brief Returns, for every function with a body, the position in functions
+ * of the last function that may call it, directly or not, or of itself.
+ *
+ * Its body is needed until that function is checked: -oob-contexts analyzes
+ * callees again for each call site, and the -oob-cache key hashes them.
+ * Walking the functions from the last one, a callee already reached from a
+ * later function is not walked again, so every call is followed once.
+ */
+static std::unordered_map<const llvm::Function *, size_t>
+lastUses(const std::vector<llvm::Function *> &functions) {
+  std::unordered_map<const llvm::Function *, size_t> ret;
+  for (size_t i = functions.size(); i-- > 0;) {
+    std::vector<const llvm::Function *> pending{functions[i]};
+    while (!pending.empty()) {
+      auto *func = pending.back();
+      pending.pop_back();
+      if (!ret.emplace(func, i).second) {
+        continue;
+      }
+      for (auto iter = llvm::inst_begin(func), end = llvm::inst_end(func); iter != end; ++iter) {
+        auto *call = llvm::dyn_cast<llvm::CallInst>(&*iter);
+        auto *callee = call ? call->getCalledFunction() : nullptr;
+        if (callee && !callee->isDeclaration()) {
+          pending.push_back(callee);
+        }
+      }
+    }
+  }
+  return ret;
+}
+
+void dataflow::checkModule(llvm::Module &module, FileReport &file, unsigned jobs,
+                           const std::vector<llvm::Function *> *candidates) {
+  llvm::raw_string_ostream out(file.out), err(file.err);
+  file.loaded = true;
+  OOBChecker checker;
+  checker.cache = Cache.get();
+  checker.diagnostics = Diagnostics.get();
+  PointerAnalysis pa(module, DemandDrivenPA, err);
+  ObjectSizeAnalysis sizes(module, pa);
+  // Before any body is deleted.
+  if (FactSnapshot) {
+    FactSnapshot->addModule(module, pa, sizes);
+  }
+  checker.snapshot = FactSnapshot.get();
+  auto summaries = SummaryTable::build(module, pa, sizes, jobs);
+  checker.summaries = summaries.get();
+  auto contexts = ContextCache::build(pa, sizes, summaries.get());
+  checker.contexts = contexts.get();
+  std::vector<llvm::Function *> functions;
+  if (candidates) {
+    functions = *candidates;
+  } else {
+    for (auto &func : module) {
+      if (!func.isDeclaration()) {
+        functions.push_back(&func);
+      }
+    }
+  }
+  // Bodies to delete after each candidate, see lastUses().
+  std::vector<std::vector<llvm::Function *>> done(functions.size());
+  if (candidates) {
+    for (auto &use : lastUses(functions)) {
+      done[use.second].push_back(const_cast<llvm::Function *>(use.first));
+    }
+  }
+  for (size_t i = 0; i < functions.size(); ++i) {
+    auto *func = functions[i];
+    out << "Running OOBCheckerPass on " << func->getName() << "\n";
+    std::string errors;
+    llvm::raw_string_ostream errStream(errors);
+    checker.analyzeAndReport(*func, pa, sizes, out, errStream);
+    errStream.flush();
+    file.functions += 1;
+    // Cached reports are only text, so count the errors in there.
+    for (size_t pos = errors.find(OOBChecker::errorMessage); pos != std::string::npos;
+         pos = errors.find(OOBChecker::errorMessage, pos + 1)) {
+      file.errors += 1;
+    }
+    file.degraded += errors.find(OOBChecker::degradedMessage) != std::string::npos;
+    err << errors;
+    // Nothing refers to these bodies any more: no function left to check
+    // calls them, and the module-wide analyses only keep names of values in
+    // other functions.
+    for (auto *unused : done[i]) {
+      unused->deleteBody();
+    }
+  }
+  Triaged.add(checker.triaged);
+}
+
+namespace {
+
+/**
+ * @brief Loads one .ll or .bc input and checks it, see checkModule() for jobs.
+ */
+void checkFile(FileReport &file, unsigned jobs) {
+  if (Lazy) {
+    LazyModule loaded;
+    llvm::raw_string_ostream err(file.err);
+    if (loadLazily(file.path, loaded, err)) {
+      err.flush();
+      checkModule(*loaded.module, file, jobs, &loaded.candidates);
+    }
+    return;
+  }
+  llvm::LLVMContext llvmContext;
+  llvm::SMDiagnostic diagnostic;
+  auto module = llvm::parseIRFile(file.path, diagnostic, llvmContext);
+  if (!module) {
+    llvm::raw_string_ostream err(file.err);
+    diagnostic.print("oobcheck", err);
+    return;
+  }
+  checkModule(*module, file, jobs);
+}
+
+/**
+ * @brief Appends the non-empty lines of the file at path to paths.
+ */
+bool readFileList(const std::string &path, std::vector<std::string> &paths) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    llvm::errs() << "oobcheck: cannot read " << path << ": " << buffer.getError().message() << "\n";
+    return false;
+  }
+  llvm::SmallVector<llvm::StringRef, 64> lines;
+  (*buffer)->getBuffer().split(lines, '\n');
+  for (auto line : lines) {
+    line = line.trim();
+    if (!line.empty()) {
+      paths.push_back(line.str());
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Prints text with prefix in front of every line.
+ */
+void printPrefixed(llvm::raw_ostream &os, llvm::StringRef prefix, llvm::StringRef text) {
+  while (!text.empty()) {
+    auto split = text.split('\n');
+    os << prefix << split.first << "\n";
+    text = split.second;
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM init(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv, "Array out-of-bounds checker\n");
+
+  if (!CacheFile.empty()) {
+    Cache = std::make_unique<ResultCache>(CacheFile);
+  }
+  Diagnostics = DiagnosticStream::open();
+  FactSnapshot = SnapshotWriter::open();
+
+  std::vector<FileReport> files;
+  if (!CompileCommands.empty()) {
+    if (!scanCompileCommands(CompileCommands, Jobs, ResourceDir, files)) {
+      return 1;
+    }
+  } else {
+    std::vector<std::string> paths(InputFiles.begin(), InputFiles.end());
+    if (!FileList.empty() && !readFileList(FileList, paths)) {
+      return 1;
+    }
+    if (paths.empty()) {
+      llvm::errs() << "oobcheck: no input files\n";
+      return 1;
+    }
+
+    files.resize(paths.size());
+#if LLVM_VERSION_MAJOR >= 11
+    llvm::ThreadPool pool(llvm::hardware_concurrency(Jobs));
+#else
+    llvm::ThreadPool pool(Jobs ? Jobs : llvm::hardware_concurrency());
+#endif
+    // The pool already runs files in parallel; only a single file gets the
+    // threads to itself.
+    unsigned jobs = paths.size() > 1 ? 1 : Jobs;
+    for (size_t i = 0; i < paths.size(); ++i) {
+      files[i].path = paths[i];
+      pool.async([&files, i, jobs] { checkFile(files[i], jobs); });
+    }
+    pool.wait();
+  }
+
+  size_t failed = 0, functions = 0, errors = 0, degraded = 0;
+  for (auto &file : files) {
+    llvm::outs() << "File " << file.path << "\n" << file.out;
+    printPrefixed(llvm::errs(), file.path + ": ", file.err);
+    failed += !file.loaded;
+    functions += file.functions;
+    errors += file.errors;
+    degraded += file.degraded;
+  }
+  llvm::outs().flush();
+  if (Cache && !Cache->save()) {
+    llvm::errs() << "oobcheck: cannot write the cache " << CacheFile << "\n";
+  }
+  if (FactSnapshot && !FactSnapshot->save()) {
+    llvm::errs() << "oobcheck: cannot write the snapshot " << SnapshotFile << "\n";
+  }
+  llvm::errs() << "oobcheck: " << files.size() << " files, " << functions << " functions, "
+               << errors << " potential array out of bounds errors";
+  if (degraded) {
+    llvm::errs() << ", " << degraded << " functions over budget";
+  }
+  if (failed) {
+    llvm::errs() << ", " << failed << " files could not be loaded";
+  }
+  llvm::errs() << "\n";
+  Triaged.print(llvm::errs());
+  printPhaseTimes(llvm::errs());
+  return failed ? 1 : 0;
+}
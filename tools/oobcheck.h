@@ -0,0 +1,36 @@
+#pragma once
+
+#include <llvm/IR/Module.h>
+#include <string>
+#include <vector>
+
+namespace dataflow {
+
+/**
+ * @brief Everything oobcheck prints for one input, collected so inputs can
+ * be checked concurrently and still be printed in order.
+ */
+struct FileReport {
+  std::string path;
+  std::string out, err;
+  bool loaded = false;
+  size_t functions = 0;
+  size_t errors = 0;
+  /// Functions whose facts were widened to top.
+  size_t degraded = 0;
+};
+
+/**
+ * @brief Checks every function defined in module, recording the output in
+ * file.
+ *
+ * @param jobs Threads that summarize the functions, 0 for one per hardware
+ * thread; 1 when several modules are checked at once, so that -j N does not
+ * start N threads for each of them.
+ * @param candidates If given, only these functions are checked, and the body
+ * of each function is deleted once no candidate left to check can call it.
+ */
+void checkModule(llvm::Module &module, FileReport &file, unsigned jobs,
+                 const std::vector<llvm::Function *> *candidates = nullptr);
+
+} // namespace dataflow
@@ -0,0 +1,258 @@
+#include "Generator.h"
+
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/Support/CommandLine.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace dataflow {
+
+static llvm::cl::opt<unsigned> Instructions(
+    "instructions", llvm::cl::desc("Instructions per generated function, roughly"),
+    llvm::cl::init(GeneratorOptions().instructions));
+
+static llvm::cl::opt<unsigned> Blocks(
+    "blocks", llvm::cl::desc("Basic blocks per generated function, roughly"),
+    llvm::cl::init(GeneratorOptions().blocks));
+
+static llvm::cl::opt<unsigned> LoopDepth(
+    "loop-depth", llvm::cl::desc("Nesting depth of the loops of each generated function"),
+    llvm::cl::init(GeneratorOptions().loopDepth));
+
+static llvm::cl::opt<unsigned> Arrays(
+    "arrays", llvm::cl::desc("Local arrays per generated function"),
+    llvm::cl::init(GeneratorOptions().arrays));
+
+static llvm::cl::opt<unsigned> Locals(
+    "locals", llvm::cl::desc("Local integer variables per generated function"),
+    llvm::cl::init(GeneratorOptions().locals));
+
+static llvm::cl::opt<unsigned> Geps(
+    "geps", llvm::cl::desc("Array accesses per generated function"),
+    llvm::cl::init(GeneratorOptions().geps));
+
+static llvm::cl::opt<double> AliasDensity(
+    "alias-density",
+    llvm::cl::desc("Probability (0 to 1) that a pointer may point to a second array"),
+    llvm::cl::init(GeneratorOptions().aliasDensity));
+
+static llvm::cl::opt<unsigned> Functions(
+    "functions", llvm::cl::desc("Number of generated functions"),
+    llvm::cl::init(GeneratorOptions().functions));
+
+static llvm::cl::opt<unsigned> Seed("seed", llvm::cl::desc("Seed of the generator"),
+                                    llvm::cl::init(GeneratorOptions().seed));
+
+GeneratorOptions generatorOptions() {
+  GeneratorOptions ret;
+  ret.instructions = Instructions;
+  ret.blocks = Blocks;
+  ret.loopDepth = LoopDepth;
+  ret.arrays = Arrays;
+  ret.locals = Locals;
+  ret.geps = Geps;
+  ret.aliasDensity = AliasDensity;
+  ret.functions = Functions;
+  ret.seed = Seed;
+  return ret;
+}
+
+namespace {
+
+/**
+ * @brief Builds one function, see GeneratorOptions.
+ */
+class FunctionGenerator {
+public:
+  FunctionGenerator(llvm::Module &module, const GeneratorOptions &options, unsigned index)
+      : _options(options), _rng(options.seed * 7919 + index), _builder(module.getContext()) {
+    auto *type = llvm::FunctionType::get(_builder.getInt32Ty(), false);
+    _func = llvm::Function::Create(type, llvm::Function::ExternalLinkage,
+                                   "f" + std::to_string(index), &module);
+  }
+
+  void generate() {
+    auto *entry = block("entry");
+    _builder.SetInsertPoint(entry);
+    declare();
+
+    // Each loop level: the preheader jumps to the header, which either
+    // enters the body or leaves to the exit, where the enclosing body goes
+    // on.
+    std::vector<llvm::BasicBlock *> headers, exits;
+    for (unsigned level = 0; level < _options.loopDepth; ++level) {
+      auto *counter = _counters[level];
+      _builder.CreateStore(_builder.getInt32(0), counter);
+      auto *header = block("for.cond");
+      auto *body = block("for.body");
+      auto *exit = block("for.end");
+      _builder.CreateBr(header);
+      _builder.SetInsertPoint(header);
+      auto *value = _builder.CreateLoad(_builder.getInt32Ty(), counter, "i");
+      auto *cmp = _builder.CreateICmpSLT(value, _builder.getInt32(bound(level)), "cmp");
+      _builder.CreateCondBr(cmp, body, exit);
+      _builder.SetInsertPoint(body);
+      headers.push_back(header);
+      exits.push_back(exit);
+    }
+
+    // The innermost body: a chain of diamonds, whose blocks get the work.
+    std::vector<llvm::BasicBlock *> slots{_builder.GetInsertBlock()};
+    unsigned skeleton = 1 + 3 * _options.loopDepth;
+    unsigned diamonds = _options.blocks > skeleton ? (_options.blocks - skeleton) / 3 : 0;
+    for (unsigned i = 0; i < diamonds; ++i) {
+      auto *value = _builder.CreateLoad(_builder.getInt32Ty(), local(), "x");
+      auto *cmp = _builder.CreateICmpSLT(value, _builder.getInt32(pick(64)), "cmp");
+      auto *then = block("if.then");
+      auto *otherwise = block("if.else");
+      auto *join = block("if.end");
+      _builder.CreateCondBr(cmp, then, otherwise);
+      for (auto *side : {then, otherwise}) {
+        _builder.SetInsertPoint(side);
+        _builder.CreateBr(join);
+        slots.push_back(side);
+      }
+      _builder.SetInsertPoint(join);
+      slots.push_back(join);
+    }
+
+    // Every level closes with the latch of its counter, then goes on in
+    // its exit.
+    for (unsigned level = _options.loopDepth; level-- > 0;) {
+      auto *counter = _counters[level];
+      auto *value = _builder.CreateLoad(_builder.getInt32Ty(), counter, "i");
+      auto *inc = _builder.CreateAdd(value, _builder.getInt32(1), "inc", false, true);
+      _builder.CreateStore(inc, counter);
+      _builder.CreateBr(headers[level]);
+      _builder.SetInsertPoint(exits[level]);
+    }
+    _builder.CreateRet(_builder.getInt32(0));
+
+    fill(slots);
+  }
+
+private:
+  const GeneratorOptions &_options;
+  std::mt19937 _rng;
+  llvm::IRBuilder<> _builder;
+  llvm::Function *_func;
+  std::vector<llvm::AllocaInst *> _arrays, _locals, _pointers, _counters;
+
+  unsigned pick(unsigned n) { return _rng() % n; }
+
+  llvm::BasicBlock *block(const char *name) {
+    return llvm::BasicBlock::Create(_builder.getContext(), name, _func);
+  }
+
+  llvm::AllocaInst *local() { return _locals[pick(_locals.size())]; }
+
+  uint64_t arraySize(unsigned i) const { return 8ull << (i % 4); }
+
+  /// Loop levels count up to the size of an array, so indexing that array
+  /// with the counter is in bounds, and indexing a smaller one is not.
+  unsigned bound(unsigned level) const {
+    return _arrays.empty() ? 10 : arraySize(level % _arrays.size());
+  }
+
+  /**
+   * The allocas of the entry block, the initial values of the locals, and
+   * the arrays the pointers point to.
+   */
+  void declare() {
+    auto *i32 = _builder.getInt32Ty();
+    for (unsigned i = 0; i < _options.arrays; ++i) {
+      auto *type = llvm::ArrayType::get(i32, arraySize(i));
+      _arrays.push_back(_builder.CreateAlloca(type, nullptr, "arr" + std::to_string(i)));
+      _pointers.push_back(
+          _builder.CreateAlloca(i32->getPointerTo(), nullptr, "p" + std::to_string(i)));
+    }
+    for (unsigned i = 0; i < std::max(1u, _options.locals); ++i) {
+      _locals.push_back(_builder.CreateAlloca(i32, nullptr, "x" + std::to_string(i)));
+    }
+    for (unsigned i = 0; i < _options.loopDepth; ++i) {
+      _counters.push_back(_builder.CreateAlloca(i32, nullptr, "i" + std::to_string(i)));
+    }
+    for (unsigned i = 0; i < _locals.size(); ++i) {
+      _builder.CreateStore(_builder.getInt32(i), _locals[i]);
+    }
+    for (unsigned i = 0; i < _arrays.size(); ++i) {
+      _builder.CreateStore(decay(_arrays[i]), _pointers[i]);
+      if (_arrays.size() > 1 && pick(1000) < _options.aliasDensity * 1000) {
+        _builder.CreateStore(decay(_arrays[(i + 1 + pick(_arrays.size() - 1)) % _arrays.size()]),
+                             _pointers[i]);
+      }
+    }
+  }
+
+  llvm::Value *decay(llvm::AllocaInst *array) {
+    auto *zero = _builder.getInt64(0);
+    return _builder.CreateInBoundsGEP(array->getAllocatedType(), array, {zero, zero}, "decay");
+  }
+
+  /**
+   * Spreads the accesses and the filler over slots, inserted before their
+   * terminators.
+   */
+  void fill(const std::vector<llvm::BasicBlock *> &slots) {
+    const unsigned accessSize = 5, fillerSize = 3;
+    size_t used = 0;
+    for (auto &block : *_func) {
+      used += block.size();
+    }
+    unsigned accesses = _arrays.empty() ? 0 : _options.geps;
+    size_t budget = used + accesses * accessSize;
+    size_t fillers = _options.instructions > budget ? (_options.instructions - budget) / fillerSize : 0;
+    for (size_t i = 0; i < accesses + fillers; ++i) {
+      _builder.SetInsertPoint(slots[i % slots.size()]->getTerminator());
+      // Accesses are spread out between the filler.
+      if (accesses && i % ((accesses + fillers) / accesses) == 0 &&
+          i / ((accesses + fillers) / accesses) < accesses) {
+        access();
+      } else {
+        filler();
+      }
+    }
+  }
+
+  /// x = y + c
+  void filler() {
+    auto *value = _builder.CreateLoad(_builder.getInt32Ty(), local(), "x");
+    auto *sum = _builder.CreateAdd(value, _builder.getInt32(pick(8) + 1), "add", false, true);
+    _builder.CreateStore(sum, local());
+  }
+
+  /// arr[i] = x or p[i] = x, with i the innermost counter or a local
+  void access() {
+    auto *i32 = _builder.getInt32Ty();
+    auto *index = _counters.empty() ? local() : _counters.back();
+    auto *value = _builder.CreateLoad(i32, index, "idx");
+    auto *wide = _builder.CreateSExt(value, _builder.getInt64Ty(), "idxprom");
+    unsigned target = pick(_arrays.size());
+    llvm::Value *element;
+    if (pick(2)) {
+      auto *ptr = _builder.CreateLoad(i32->getPointerTo(), _pointers[target], "ptr");
+      element = _builder.CreateInBoundsGEP(i32, ptr, wide, "arrayidx");
+    } else {
+      auto *array = _arrays[target];
+      element = _builder.CreateInBoundsGEP(array->getAllocatedType(), array,
+                                           {_builder.getInt64(0), wide}, "arrayidx");
+    }
+    _builder.CreateStore(_builder.getInt32(0), element);
+  }
+};
+
+} // namespace
+
+std::unique_ptr<llvm::Module> generateModule(llvm::LLVMContext &context,
+                                             const GeneratorOptions &options) {
+  auto module = std::make_unique<llvm::Module>("oobgen", context);
+  module->setSourceFileName("oobgen.c");
+  for (unsigned i = 0; i < options.functions; ++i) {
+    FunctionGenerator(*module, options, i).generate();
+  }
+  return module;
+}
+
+} // namespace dataflow
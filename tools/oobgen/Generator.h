@@ -0,0 +1,53 @@
+#pragma once
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <memory>
+
+namespace dataflow {
+
+/**
+ * @brief The shape of the functions generateModule() builds.
+ *
+ * Each function declares its arrays, integer locals and one pointer per
+ * array in the entry block, like clang -O0 does. It then runs a nest of
+ * loopDepth counted loops, each bounded by the size of one of the arrays.
+ * The innermost body is a chain of if/else diamonds, as many as blocks
+ * allows, whose blocks share the array accesses and enough filler
+ * arithmetic on the locals to reach about the requested number of
+ * instructions. An access goes through one of the pointers or directly into
+ * an array, indexed by the innermost loop counter, so some of them are out
+ * of bounds.
+ */
+struct GeneratorOptions {
+  /// Instructions per function, roughly: never fewer than the skeleton needs.
+  unsigned instructions = 200;
+  /// Basic blocks per function, roughly: the entry, 3 per loop and 3 per
+  /// diamond.
+  unsigned blocks = 8;
+  unsigned loopDepth = 0;
+  unsigned arrays = 4;
+  /// Integer locals the filler reads and writes, the width of the facts.
+  unsigned locals = 8;
+  /// Array accesses per function.
+  unsigned geps = 8;
+  /// Probability that a pointer is also assigned a second array, which the
+  /// points-to analysis then merges.
+  double aliasDensity = 0.25;
+  unsigned functions = 1;
+  unsigned seed = 1;
+};
+
+/**
+ * @brief Returns the options given on the command line.
+ */
+GeneratorOptions generatorOptions();
+
+/**
+ * @brief Builds a module of options.functions functions named f0, f1, ...
+ * The same options and seed always build the same module.
+ */
+std::unique_ptr<llvm::Module> generateModule(llvm::LLVMContext &context,
+                                             const GeneratorOptions &options);
+
+} // namespace dataflow
@@ -0,0 +1,46 @@
+/**
+ * @file oobgen.cpp
+ * @brief Writes synthetic modules for the scaling benchmarks of oobbench.
+ *
+ * Usage: oobgen [-instructions N] [-blocks N] [-loop-depth N] [-arrays N]
+ *               [-locals N] [-geps N] [-alias-density P] [-functions N]
+ *               [-seed N] [-o <file>]
+ *
+ * Writes the module generateModule() builds for the options as textual IR,
+ * to stdout by default, so it can be given to opt or oobcheck as is. See
+ * GeneratorOptions for the shape of the functions.
+ */
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/InitLLVM.h>
+#include <llvm/Support/raw_ostream.h>
+#include <string>
+
+#include "Generator.h"
+
+using namespace dataflow;
+
+static llvm::cl::opt<std::string> OutputFile("o", llvm::cl::desc("Output file ('-' for stdout)"),
+                                             llvm::cl::value_desc("filename"),
+                                             llvm::cl::init("-"));
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM init(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv, "Generates modules to benchmark the checker on\n");
+
+  llvm::LLVMContext context;
+  auto module = generateModule(context, generatorOptions());
+  if (llvm::verifyModule(*module, &llvm::errs())) {
+    llvm::errs() << "oobgen: the generated module is broken\n";
+    return 1;
+  }
+  std::error_code ec;
+  llvm::raw_fd_ostream out(OutputFile, ec);
+  if (ec) {
+    llvm::errs() << "oobgen: " << OutputFile << ": " << ec.message() << "\n";
+    return 1;
+  }
+  module->print(out, nullptr);
+  return 0;
+}
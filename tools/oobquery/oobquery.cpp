@@ -0,0 +1,254 @@
+/**
+ * @file oobquery.cpp
+ * @brief Answers questions about the facts of a run from its -oob-snapshot.
+ *
+ * Usage: oobquery <snapshot>
+ *        oobquery <snapshot> -function <name> [-instruction <name> | -line N]
+ *                 [-value <name>]
+ *        oobquery <snapshot> [-function <name>] -sizes | -value-numbers
+ *
+ * Without -function, lists the functions of the snapshot. With -function,
+ * lists its instructions, or, with -instruction or -line, prints the facts
+ * before and after the instructions it selects. -value narrows the facts
+ * down to one value, at every instruction unless one is selected, and adds
+ * its array size. -sizes and -value-numbers print the object size table and
+ * the variables the points-to analysis merged, of the function's module or
+ * of every module.
+ */
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/InitLLVM.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Snapshot.h"
+
+using namespace dataflow;
+
+static llvm::cl::opt<std::string> InputFile(llvm::cl::Positional, llvm::cl::Required,
+                                            llvm::cl::desc("<snapshot>"));
+
+static llvm::cl::opt<std::string> FunctionName(
+    "function", llvm::cl::desc("Query the facts of this function"), llvm::cl::value_desc("name"));
+
+static llvm::cl::opt<std::string> InstructionName(
+    "instruction",
+    llvm::cl::desc("Print the facts at this instruction: its name (%idx), its position (#12), or "
+                   "the instruction of a -oob-diagnostics record"),
+    llvm::cl::value_desc("instruction"));
+
+static llvm::cl::opt<unsigned> Line(
+    "line", llvm::cl::desc("Print the facts at the instructions of this source line"),
+    llvm::cl::init(0));
+
+static llvm::cl::opt<std::string> ValueName(
+    "value", llvm::cl::desc("Only print the range of this value"), llvm::cl::value_desc("name"));
+
+static llvm::cl::opt<bool> PrintSizes("sizes", llvm::cl::desc("Print the object size table"));
+
+static llvm::cl::opt<bool> PrintValueNumbers(
+    "value-numbers", llvm::cl::desc("Print the variables merged by value numbering"));
+
+namespace {
+
+/**
+ * @brief Does the instruction at position pos called name match what
+ * -instruction asks for?
+ */
+bool selected(llvm::StringRef query, size_t pos, llvm::StringRef name) {
+  if (query.startswith("#")) {
+    return query.drop_front() == std::to_string(pos);
+  }
+  // "%idx = getelementptr ..." as printed in a diagnostic record.
+  return name == query.trim() || (query.contains(" = ") && name == query.split(" = ").first.trim());
+}
+
+/**
+ * @brief Prints domain without the space operator<< ends it with.
+ */
+std::string text(const IntervalDomain &domain) {
+  std::string ret;
+  llvm::raw_string_ostream os(ret);
+  (llvm::raw_ostream &)os << domain;
+  return llvm::StringRef(os.str()).rtrim().str();
+}
+
+void printFacts(llvm::raw_ostream &os, llvm::StringRef title, const FactMap &facts) {
+  std::map<std::string, IntervalDomain> sorted(facts.begin(), facts.end());
+  os << "  " << title << ":";
+  if (sorted.empty()) {
+    os << " none";
+  }
+  os << "\n";
+  for (auto &fact : sorted) {
+    os << "    " << fact.first << " |-> " << text(fact.second) << "\n";
+  }
+}
+
+void printRange(llvm::raw_ostream &os, const FactMap &facts, const FactMap &constants) {
+  if (facts.contains(ValueName)) {
+    os << text(facts[ValueName]);
+  } else if (constants.contains(ValueName)) {
+    os << text(constants[ValueName]) << " (tiers)";
+  } else {
+    os << "not tracked";
+  }
+}
+
+void printSize(llvm::raw_ostream &os, const Snapshot::Size &size) {
+  os << size.value << ": " << text(size.elements);
+  if (!size.symbol.empty()) {
+    os << ", or " << size.symbol << " * " << size.scale << " / " << size.divisor << " - "
+       << size.offset;
+  }
+  os << "\n";
+}
+
+/**
+ * @brief Answers the query for one function.
+ * @return false if its blob is damaged.
+ */
+bool query(const Snapshot &snapshot, const Snapshot::Function &func, llvm::raw_ostream &os) {
+  std::vector<Snapshot::Instruction> instructions;
+  FactMap constants;
+  auto modules = snapshot.modules();
+  if (func.module >= modules.size() || !snapshot.instructions(func, instructions) ||
+      !snapshot.constants(func, constants)) {
+    return false;
+  }
+  os << "Function " << func.name << " in " << modules[func.module] << "\n";
+  if (!ValueName.empty()) {
+    for (auto &size : snapshot.sizes(func.module)) {
+      if (size.value == func.name + "::" + ValueName || size.value == ValueName) {
+        os << "  size of ";
+        printSize(os, size);
+      }
+    }
+  }
+
+  bool selecting = !InstructionName.empty() || Line;
+  if (!selecting && constants.contains(ValueName)) {
+    os << "  " << ValueName << " |-> " << text(constants[ValueName]) << " (tiers)\n";
+  }
+  if (!selecting && ValueName.empty()) {
+    for (size_t i = 0; i < instructions.size(); ++i) {
+      os << "  #" << i << " " << instructions[i].block << " " << instructions[i].name;
+      if (instructions[i].line) {
+        os << " (line " << instructions[i].line << ")";
+      }
+      os << "\n";
+    }
+    if (constants.size()) {
+      printFacts(os, "resolved by the tiers", constants);
+    }
+    return true;
+  }
+
+  for (size_t i = 0; i < instructions.size(); ++i) {
+    auto &ins = instructions[i];
+    if ((!InstructionName.empty() && !selected(InstructionName, i, ins.name)) ||
+        (Line && ins.line != Line)) {
+      continue;
+    }
+    FactMap in, out;
+    if (!snapshot.facts(func, i, in, out)) {
+      return false;
+    }
+    if (!ValueName.empty()) {
+      if (!selecting && !in.contains(ValueName) && !out.contains(ValueName)) {
+        continue;
+      }
+      os << "  #" << i << " " << ins.name << ": before ";
+      printRange(os, in, constants);
+      os << ", after ";
+      printRange(os, out, constants);
+      os << "\n";
+      continue;
+    }
+    os << "#" << i << " " << ins.block << " " << ins.name << "\n";
+    printFacts(os, "IN", in);
+    printFacts(os, "OUT", out);
+  }
+  if (selecting && ValueName.empty() && constants.size()) {
+    printFacts(os, "resolved by the tiers", constants);
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM init(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv, "Queries the snapshots of -oob-snapshot\n");
+
+  std::string error;
+  auto snapshot = Snapshot::open(InputFile, error);
+  if (!snapshot) {
+    llvm::errs() << "oobquery: " << InputFile << ": " << error << "\n";
+    return 1;
+  }
+  llvm::raw_ostream &os = llvm::outs();
+  auto modules = snapshot->modules();
+
+  std::vector<Snapshot::Function> functions;
+  if (!FunctionName.empty()) {
+    functions = snapshot->find(FunctionName);
+    if (functions.empty()) {
+      llvm::errs() << "oobquery: " << FunctionName << " is not in " << InputFile << "\n";
+      return 1;
+    }
+  }
+
+  if (PrintSizes || PrintValueNumbers) {
+    for (uint32_t module = 0; module < modules.size(); ++module) {
+      if (!functions.empty() &&
+          std::none_of(functions.begin(), functions.end(),
+                       [module](const Snapshot::Function &func) { return func.module == module; })) {
+        continue;
+      }
+      os << "Module " << modules[module] << "\n";
+      // Only the values of the function, if one is given.
+      auto prefix = FunctionName.empty() ? std::string() : FunctionName + "::";
+      if (PrintSizes) {
+        for (auto &size : snapshot->sizes(module)) {
+          if (llvm::StringRef(size.value).startswith(prefix)) {
+            os << "  ";
+            printSize(os, size);
+          }
+        }
+      }
+      if (PrintValueNumbers) {
+        for (auto &merged : snapshot->valueNumbers(module)) {
+          if (llvm::StringRef(merged.first).startswith(prefix)) {
+            os << "  " << merged.first << " -> " << merged.second << "\n";
+          }
+        }
+      }
+    }
+    return 0;
+  }
+
+  if (FunctionName.empty()) {
+    for (auto &func : snapshot->functions()) {
+      os << func.name << " (" << (func.module < modules.size() ? modules[func.module] : "?")
+         << "): "
+         << (func.fixpoint ? "fixpoint" : "tiers only");
+      if (func.degraded) {
+        os << ", widened to top";
+      }
+      os << "\n";
+    }
+    return 0;
+  }
+
+  for (auto &func : functions) {
+    if (!query(*snapshot, func, os)) {
+      llvm::errs() << "oobquery: the facts of " << func.name << " are damaged\n";
+      return 1;
+    }
+  }
+  return 0;
+}
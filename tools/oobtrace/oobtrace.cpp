@@ -0,0 +1,87 @@
+/**
+ * @file oobtrace.cpp
+ * @brief Offline reader of the traces -oob-trace records.
+ *
+ * Usage: oobtrace <trace>
+ *        oobtrace <trace> -function <name> [-visit N]
+ *
+ * Without -function, lists the traced functions with their number of
+ * visits. With -function, rebuilds the IN and OUT facts of every instruction
+ * of that function as they were after its first N visits (after all of them
+ * by default), and prints them like -oob-verbose=2 does. A function that was
+ * analyzed several times, for instance per call site, is printed once for
+ * each time.
+ */
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/InitLLVM.h>
+#include <llvm/Support/raw_ostream.h>
+#include <string>
+#include <vector>
+
+#include "Trace.h"
+#include "Utils.h"
+
+using namespace dataflow;
+
+static llvm::cl::opt<std::string> InputFile(llvm::cl::Positional, llvm::cl::Required,
+                                            llvm::cl::desc("<trace>"));
+
+static llvm::cl::opt<std::string> FunctionName(
+    "function", llvm::cl::desc("Print the facts of this function"),
+    llvm::cl::value_desc("name"));
+
+static llvm::cl::opt<uint64_t> VisitCount(
+    "visit", llvm::cl::desc("Print the facts after this many visits (default: all)"),
+    llvm::cl::init(UINT64_MAX));
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM init(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv, "Replays the traces of -oob-trace\n");
+
+  std::vector<TraceFunction> functions;
+  std::string error;
+  if (!readTrace(InputFile, functions, FunctionName.empty() ? nullptr : &FunctionName.getValue(),
+                 error)) {
+    llvm::errs() << "oobtrace: " << InputFile << ": " << error << "\n";
+    return 1;
+  }
+
+  if (FunctionName.empty()) {
+    for (auto &func : functions) {
+      llvm::outs() << func.name << ": " << func.instructions.size() << " instructions, "
+                   << func.visitCount << " visits, " << func.slots.size() << " facts, "
+                   << func.domains.size() << " domains";
+      if (func.degraded) {
+        llvm::outs() << ", widened to top";
+      }
+      if (!func.finished) {
+        llvm::outs() << ", incomplete";
+      }
+      llvm::outs() << "\n";
+    }
+    return 0;
+  }
+
+  bool found = false;
+  std::vector<FactMap> in, out;
+  FactWriter writer(llvm::outs());
+  for (auto &func : functions) {
+    if (func.name != FunctionName) {
+      continue;
+    }
+    found = true;
+    auto count = std::min<uint64_t>(VisitCount, func.visitCount);
+    func.replay(count, in, out);
+    llvm::outs() << "Function " << func.name << " after " << count << " of " << func.visitCount
+                 << " visits\n";
+    for (size_t i = 0; i < func.instructions.size(); ++i) {
+      writer.write(func.instructions[i], in[i], out[i]);
+    }
+    writer.flush();
+  }
+  if (!found) {
+    llvm::errs() << "oobtrace: " << FunctionName << " is not in " << InputFile << "\n";
+    return 1;
+  }
+  return 0;
+}
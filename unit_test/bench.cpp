@@ -0,0 +1,180 @@
+/**
+ * @file bench.cpp
+ * @brief Microbenchmarks of Interval, IntervalDomain and FactMap, built
+ * without LLVM like the unit tests.
+ *
+ * Usage: ./bench [filter...]
+ *
+ * Runs the benchmarks whose name contains one of the filters, or all of
+ * them, each long enough to take at least BENCH_MIN_MS milliseconds (100 by
+ * default), and prints the time and the number of heap allocations per
+ * operation. The maps and domains an operation works on are built once, so
+ * only the operation itself is measured.
+ */
+#include "Interval.h"
+#include "Domain.h"
+#include "FactMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace dataflow;
+
+namespace {
+
+size_t Allocations = 0;
+
+} // namespace
+
+void *operator new(std::size_t size) {
+    ++Allocations;
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+std::vector<const char *> Filters;
+double MinSeconds = 0.1;
+
+/**
+ * @brief Keeps the compiler from dropping the computation of value.
+ */
+template <typename T>
+void keep(T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * @brief Runs body(i) for i = 0, 1, ... until it took MinSeconds, doubling
+ * the number of iterations, and prints the cost of one call.
+ */
+template <typename Body>
+void run(const std::string &name, Body body) {
+    if (!Filters.empty()) {
+        bool selected = false;
+        for (auto filter : Filters) {
+            selected |= name.find(filter) != std::string::npos;
+        }
+        if (!selected) {
+            return;
+        }
+    }
+    for (size_t iterations = 1;; iterations *= 2) {
+        auto allocations = Allocations;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            body(i);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        allocations = Allocations - allocations;
+        if (elapsed.count() >= MinSeconds) {
+            std::printf("%-32s %12.1f ns/op %10.2f allocs/op %12zu iterations\n", name.c_str(),
+                        elapsed.count() * 1e9 / iterations, (double)allocations / iterations,
+                        iterations);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Returns a domain of k disjoint intervals of width 4, spaced by
+ * step and starting at offset.
+ */
+IntervalDomain intervals(int k, int offset, int step = 16) {
+    auto ret = IntervalDomain::EMPTY();
+    for (int i = 0; i < k; ++i) {
+        ret.insert(Interval(offset + i * step, offset + i * step + 3));
+    }
+    return ret;
+}
+
+/**
+ * @brief Returns a fact map of n variables, with keys padded like
+ * variable() pads them.
+ */
+FactMap facts(int n, int offset) {
+    FactMap ret;
+    for (int i = 0; i < n; ++i) {
+        auto key = "%v" + std::to_string(i);
+        key.resize(std::max<size_t>(key.size(), 8), ' ');
+        ret[key] = IntervalDomain(i + offset, i + offset + 10);
+    }
+    return ret;
+}
+
+void benchInterval() {
+    // Operands cycle through a table so nothing is folded away.
+    std::vector<Interval> operands;
+    for (int i = 0; i < 64; ++i) {
+        operands.emplace_back(i - 32, i * 3 + 1);
+    }
+    auto operand = [&operands](size_t i) -> const Interval & { return operands[i % 64]; };
+    run("Interval +", [&](size_t i) { auto r = operand(i) + operand(i + 7); keep(r); });
+    run("Interval -", [&](size_t i) { auto r = operand(i) - operand(i + 7); keep(r); });
+    run("Interval *", [&](size_t i) { auto r = operand(i) * operand(i + 7); keep(r); });
+    run("Interval /", [&](size_t i) { auto r = operand(i) / operand(i + 7); keep(r); });
+    run("Interval | (join)", [&](size_t i) { auto r = operand(i) | operand(i + 7); keep(r); });
+    run("Interval & (meet)", [&](size_t i) { auto r = operand(i) & operand(i + 7); keep(r); });
+}
+
+void benchDomain() {
+    for (int k : {1, 2, 4, 8, 16, 32}) {
+        auto a = intervals(k, 0), b = intervals(k, 8), same = a;
+        auto suffix = " k=" + std::to_string(k);
+        run("IntervalDomain | (join)" + suffix, [&](size_t) { auto r = a | b; keep(r); });
+        run("IntervalDomain & (meet)" + suffix, [&](size_t) { auto r = a & b; keep(r); });
+        run("IntervalDomain +" + suffix, [&](size_t) { auto r = a + b; keep(r); });
+        run("IntervalDomain *" + suffix, [&](size_t) { auto r = a * b; keep(r); });
+        run("IntervalDomain ==" + suffix, [&](size_t) { bool r = a == same; keep(r); });
+        // An interval that overlaps one already there: maintain() merges it
+        // back, so the domain keeps k intervals.
+        auto merged = a;
+        run("IntervalDomain maintain" + suffix, [&](size_t i) {
+            auto lo = (int)(i % k) * 16 + 1;
+            merged.insert(Interval(lo, lo + 1));
+            keep(merged);
+        });
+    }
+}
+
+void benchFactMap() {
+    for (int n : {8, 64, 512, 4096}) {
+        auto suffix = " n=" + std::to_string(n);
+        // The join of the fixpoint: the keys are there already and the
+        // domains stop changing after the first join.
+        auto in = facts(n, 0), out = facts(n, 5);
+        run("FactMap += (same keys)" + suffix, [&](size_t) { in += out; keep(in); });
+        auto copy = out;
+        run("FactMap == (equal)" + suffix, [&](size_t) { bool r = out == copy; keep(r); });
+        run("FactMap copy" + suffix, [&](size_t) { auto r = out; keep(r); });
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (auto ms = std::getenv("BENCH_MIN_MS")) {
+        MinSeconds = std::atof(ms) / 1000;
+    }
+    for (int i = 1; i < argc; ++i) {
+        Filters.push_back(argv[i]);
+    }
+    benchInterval();
+    benchDomain();
+    benchFactMap();
+    return 0;
+}
@@ -94,6 +94,16 @@ TEST_CASE("basic arithmetic", "[interval]") {
         REQUIRE((D{-1,2}/D{-4,-3} == D{0}));
         REQUIRE((D{1,2}/D{-3,4} == D{0,INF.upper()}));      
     }
+
+    SECTION("saturation") {
+        REQUIRE((INF+D{1}) == INF);
+        REQUIRE((INF-D{1}) == INF);
+        REQUIRE((INF*D{4}) == INF);
+        REQUIRE((D{0,INF.upper()}*D{4}) == D{0,INF.upper()});
+        REQUIRE((D{INF.upper()-1}+D{5}) == D{INF.upper()});
+        REQUIRE((D{INF.lower()+1}-D{5}) == D{INF.lower()});
+        REQUIRE((D{1,INF.upper()}-D{1,INF.upper()}) == INF);
+    }
 }
 
 TEST_CASE("comparison", "[interval]") {
@@ -134,4 +144,45 @@ TEST_CASE("domain arithmetic", "[domain]") {
         REQUIRE((D{-2,1}+D{-4,3} == D{-6,4}));
     }
 
+    SECTION("insertion") {
+        auto d = D::EMPTY();
+        d.insert(Interval(5, 6));
+        d.insert(Interval(1, 2));
+        REQUIRE(d.size() == 2);
+        REQUIRE(d.contains(1));
+        REQUIRE(!d.contains(3));
+        REQUIRE(d.contains(6));
+        d.insert(Interval(2, 5));
+        REQUIRE(d == D{1,6});
+
+        auto unknown = D::UNINIT();
+        unknown.insert(Interval(1, 2));
+        REQUIRE(unknown.isUnknown());
+    }
+
+    SECTION("widening") {
+        auto d = D{0,1};
+        d.widen(D{0,1});
+        REQUIRE(d == D{0,1});
+        d.widen(D{0,2});
+        REQUIRE(d == D{0,Interval::INT_INF});
+        d.widen(D{-1,5});
+        REQUIRE(d == D::INF_DOMAIN());
+
+        auto gaps = D::EMPTY();
+        gaps.insert(Interval(0, 0));
+        gaps.insert(Interval(9, 9));
+        auto filled = gaps;
+        filled.insert(Interval(4, 4));
+        gaps.widen(filled);
+        REQUIRE(gaps == D{0,9});
+
+        auto empty = D::EMPTY();
+        empty.widen(D{3,4});
+        REQUIRE(empty == D{3,4});
+        d = D{1,2};
+        d.widen(D::UNINIT());
+        REQUIRE(d.isUnknown());
+    }
+
 }